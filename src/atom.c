@@ -0,0 +1,109 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulse/xmalloc.h>
+
+#include "atom.h"
+
+
+struct pa_policy_atom_table {
+    uint32_t    refcnt;
+    pa_hashmap *ids;    /* name => atom + 1 */
+    char      **names;  /* atom => name */
+    uint32_t    natom;
+    uint32_t    size;
+};
+
+static struct pa_policy_atom_table *table;
+
+
+void pa_policy_atom_table_ref(void)
+{
+    if (table == NULL) {
+        table = pa_xnew0(struct pa_policy_atom_table, 1);
+        table->ids = pa_hashmap_new(pa_idxset_string_hash_func,
+                                    pa_idxset_string_compare_func);
+    }
+
+    table->refcnt++;
+}
+
+void pa_policy_atom_table_unref(void)
+{
+    uint32_t i;
+
+    pa_assert(table);
+    pa_assert(table->refcnt > 0);
+
+    if (--table->refcnt > 0)
+        return;
+
+    pa_hashmap_free(table->ids);
+
+    for (i = 0;  i < table->natom;  i++)
+        pa_xfree(table->names[i]);
+
+    pa_xfree(table->names);
+    pa_xfree(table);
+
+    table = NULL;
+}
+
+pa_policy_atom pa_policy_atom_intern(const char *name)
+{
+    pa_policy_atom atom;
+    void *id;
+
+    pa_assert(table);
+    pa_assert(name);
+
+    if ((id = pa_hashmap_get(table->ids, name)) != NULL)
+        return PA_PTR_TO_UINT32(id) - 1;
+
+    if (table->natom >= table->size) {
+        table->size  = table->size ? table->size * 2 : 32;
+        table->names = pa_xrenew(char *, table->names, table->size);
+    }
+
+    atom = table->natom++;
+    table->names[atom] = pa_xstrdup(name);
+
+    pa_hashmap_put(table->ids, table->names[atom], PA_UINT32_TO_PTR(atom + 1));
+
+    return atom;
+}
+
+pa_policy_atom pa_policy_atom_lookup(const char *name)
+{
+    void *id;
+
+    pa_assert(table);
+
+    if (name == NULL || (id = pa_hashmap_get(table->ids, name)) == NULL)
+        return PA_POLICY_ATOM_INVALID;
+
+    return PA_PTR_TO_UINT32(id) - 1;
+}
+
+const char *pa_policy_atom_name(pa_policy_atom atom)
+{
+    pa_assert(table);
+
+    if (atom >= table->natom)
+        return NULL;
+
+    return table->names[atom];
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,30 @@
+#ifndef fooatomfoo
+#define fooatomfoo
+
+#include <stdint.h>
+
+/* Atoms are small integer ids for the group names and device types.
+ * The table is shared by all instances of the module in the process;
+ * every instance takes a reference when it is loaded. Names are never
+ * removed from the table, so an atom and its name stay valid as long
+ * as any reference is held. */
+typedef uint32_t pa_policy_atom;
+
+#define PA_POLICY_ATOM_INVALID ((pa_policy_atom) -1)
+
+void pa_policy_atom_table_ref(void);
+void pa_policy_atom_table_unref(void);
+
+pa_policy_atom pa_policy_atom_intern(const char *name);
+pa_policy_atom pa_policy_atom_lookup(const char *name);
+const char *pa_policy_atom_name(pa_policy_atom atom);
+
+#endif /* fooatomfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
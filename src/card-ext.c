@@ -7,6 +7,7 @@
 #include <pulsecore/card.h>
 
 #include "card-ext.h"
+#include "index-hash.h"
 #include "classify.h"
 #include "context.h"
 #include "policy.h"
@@ -87,6 +88,14 @@ void pa_card_ext_discover(struct userdata *u)
         handle_new_card(u, card);
 }
 
+struct pa_card_ext *pa_card_ext_lookup(struct userdata *u, struct pa_card *card)
+{
+    pa_assert(u);
+    pa_assert(card);
+
+    return pa_index_hash_lookup(u->hcrd, card->index);
+}
+
 const char *pa_card_ext_get_name(struct pa_card *card)
 {
     return card->name ? card->name : "<unknown>";
@@ -100,59 +109,85 @@ pa_hashmap *pa_card_ext_get_profiles(struct pa_card *card)
     return card->profiles;
 }
 
-int pa_card_ext_set_profile(struct userdata *u, char *type)
-{    
-    void            *state = NULL;
-    pa_idxset       *idxset;
-    struct pa_card  *card;
-    struct pa_classify_card_data *data;
-    struct pa_classify_card_data *datas[PA_POLICY_CARD_MAX_DEFS] = { NULL, NULL };
-    struct pa_card  *cards[PA_POLICY_CARD_MAX_DEFS] = { NULL, NULL };
-    int              priority;
+/* Return the profile card should be switched to, or NULL if it stays. */
+static pa_card_profile *card_new_profile(struct userdata *u,
+                                         struct pa_card *card,
+                                         struct pa_classify_card_data *data)
+{
     const char      *pn;
     const char      *override_pn;
-    const char      *cn;
-    pa_card_profile *ap;
     pa_card_profile *new_profile;
-    int              sts;
+
+    if (!(pn = data->profile))
+        return NULL;
+
+    if (pa_context_override_card_profile(u, card, pn, &override_pn))
+        pn = override_pn;
+
+    new_profile = pa_hashmap_get(card->profiles, pn);
+
+    if (!new_profile || new_profile == card->active_profile)
+        return NULL;
+
+    return new_profile;
+}
+
+void pa_card_ext_collect_profile_changes(struct userdata *u, const char *type,
+                                         pa_idxset *changing,
+                                         struct pa_card_ext_profile_change *changes)
+{
+    struct pa_classify_card_data *data;
+    struct pa_card  *card;
+    pa_card_profile *new_profile;
     int              i;
 
     pa_assert(u);
-    pa_assert(u->core);
-    pa_assert_se((idxset = u->core->cards));
+    pa_assert(changing);
+    pa_assert(changes);
 
-    sts = 0;
+    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++) {
+        changes[i].card    = NULL;
+        changes[i].profile = NULL;
+    }
 
-    while ((card = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_card_typeof(u, card, type, &data, &priority)) {
-            if (priority == 0) {
-                datas[0] = data;
-                cards[0] = card;
-            }
-            if (priority == 1) {
-                datas[1] = data;
-                cards[1] = card;
-            }
+    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++) {
+        if (!(card = pa_classify_find_card(u, type, i, &data)))
+            break;
+
+        if ((new_profile = card_new_profile(u, card, data))) {
+            changes[i].card    = card;
+            changes[i].profile = new_profile;
+            pa_idxset_put(changing, card, NULL);
         }
     }
+}
+
+int pa_card_ext_set_profile(struct userdata *u,
+                            const struct pa_card_ext_profile_change *changes)
+{    
+    struct pa_card  *card;
+    const char      *pn;
+    const char      *cn;
+    pa_card_profile *new_profile;
+    int              sts;
+    int              i;
 
-    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS && datas[i]; i++) {
+    pa_assert(u);
+    pa_assert(u->core);
+    pa_assert(changes);
 
-        data = datas[i];
-        card = cards[i];
+    sts = 0;
 
-        ap = card->active_profile;
-        pn = data->profile;
-        if (!pn)
-            continue;
+    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++) {
 
-        if (pa_context_override_card_profile(u, card, pn, &override_pn))
-            pn = override_pn;
+        card        = changes[i].card;
+        new_profile = changes[i].profile;
 
-        new_profile = pa_hashmap_get(card->profiles, pn);
-        cn = pa_card_ext_get_name(card);
+        /* An earlier decision may have switched the card already. */
+        if (new_profile && new_profile != card->active_profile) {
+            pn = new_profile->name;
+            cn = pa_card_ext_get_name(card);
 
-        if (new_profile && (!ap || ap != new_profile)) {
             if (pa_card_set_profile(card, new_profile, false) < 0) {
                 sts = -1;
                 pa_log("failed to set card '%s' profile to '%s'", cn, pn);
@@ -217,11 +252,17 @@ static void handle_new_card(struct userdata *u, struct pa_card *card)
     uint32_t                    idx;
     int                         ret;
     char                       *buf;
+    struct pa_card_ext         *ext;
 
     if (card && u) {
         name = pa_card_ext_get_name(card);
         idx  = card->index;
 
+        ext = pa_xnew0(struct pa_card_ext, 1);
+        pa_index_hash_add(u->hcrd, idx, ext);
+
+        pa_classify_register_card(u, card);
+
         pa_policy_context_register(u, pa_policy_object_card, name, card);
 
         if (pa_policy_log_level_debug()) {
@@ -254,12 +295,14 @@ static void handle_removed_card(struct userdata *u, struct pa_card *card)
     const char *name;
     uint32_t  idx;
     struct pa_classify_result *r;
+    struct pa_card_ext *ext;
     char *buf;
 
     if (card && u) {
         name = pa_card_ext_get_name(card);
         idx  = card->index;
 
+        pa_classify_unregister_card(u, card);
         pa_policy_context_unregister(u, pa_policy_object_card, name, card, idx);
 
         if (pa_policy_log_level_debug()) {
@@ -274,6 +317,13 @@ static void handle_removed_card(struct userdata *u, struct pa_card *card)
         pa_classify_card(u, card, PA_POLICY_DISABLE_NOTIFY, 0, false, &r);
         pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, r);
         pa_xfree(r);
+
+        if ((ext = pa_index_hash_remove(u->hcrd, idx)) == NULL)
+            pa_log("no extension found for card '%s' (idx=%u)", name, idx);
+        else {
+            pa_classify_memo_free(ext->memo);
+            pa_xfree(ext);
+        }
     }
 }
 
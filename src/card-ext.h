@@ -3,6 +3,8 @@
 
 #include "userdata.h"
 
+struct pa_classify_memo;
+
 struct pa_card_evsubscr {
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
@@ -10,12 +12,30 @@ struct pa_card_evsubscr {
     pa_hook_slot    *changed;
 };
 
+struct pa_card_ext {
+    struct pa_classify_memo *memo; /* device types of the card */
+};
+
+/* Profile a card of a device type is to be switched to */
+struct pa_card_ext_profile_change {
+    struct pa_card          *card;
+    pa_card_profile         *profile;
+};
+
 struct pa_card_evsubscr *pa_card_ext_subscription(struct userdata *);
 void pa_card_ext_subscription_free(struct pa_card_evsubscr *);
 void pa_card_ext_discover(struct userdata *);
+struct pa_card_ext *pa_card_ext_lookup(struct userdata *, struct pa_card *);
 const char *pa_card_ext_get_name(struct pa_card *);
 pa_hashmap *pa_card_ext_get_profiles(struct pa_card *card);
-int pa_card_ext_set_profile(struct userdata *, char *);
+/* Decide the profiles the cards of a device type are switched to. The
+ * changing cards are added to the given set and their new profiles are
+ * stored in the array, to be applied by pa_card_ext_set_profile(). */
+void pa_card_ext_collect_profile_changes(struct userdata *, const char *,
+                                         pa_idxset *,
+                                         struct pa_card_ext_profile_change *);
+int pa_card_ext_set_profile(struct userdata *,
+                            const struct pa_card_ext_profile_change *);
 
 #endif
 
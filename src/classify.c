@@ -26,42 +26,66 @@
 #include "variable.h"
 #include "context.h"
 #include "match.h"
+#include "atom.h"
 
 
 
-static const char *find_group_for_client(struct userdata *, struct pa_client *,
-                                         pa_proplist *, uint32_t *);
+static struct pa_policy_group *find_group_for_client(struct userdata *,
+                                                    struct pa_client *,
+                                                    pa_proplist *, uint32_t *);
 #if 0
 static char *arg_dump(int, char **, char *, size_t);
 #endif
 
 static void  pid_hash_free(struct pa_classify_pid_hash *);
 static void  pid_hash_free_all(struct pa_classify_pid_hash **);
-static void  pid_hash_insert(struct pa_classify_pid_hash **, pid_t,
+static void  pid_hash_insert(struct pa_classify_pid_hash **, struct pa_policy_group *, pid_t,
                              const char *, enum pa_classify_method,
                              const char *, const char *);
 static void  pid_hash_remove(struct pa_classify_pid_hash **, pid_t,
                              const char *, enum pa_classify_method,
                              const char *);
-static char *pid_hash_get_group(struct pa_classify_pid_hash **, pid_t,
-                                pa_proplist *);
+static struct pa_policy_group *pid_hash_get_group(struct pa_classify_pid_hash **,
+                                                 pid_t, pa_proplist *);
 static struct pa_classify_pid_hash
             *pid_hash_find(struct pa_classify_pid_hash **, pid_t,
                            const char *, enum pa_classify_method, const char *,
                            struct pa_classify_pid_hash **);
 
 static void streams_free(struct pa_classify_stream_def *);
-static void streams_add(struct userdata *u, struct pa_classify_stream_def **, const char *,
+static void streams_add(struct userdata *u, struct pa_classify_stream *, const char *,
                         enum pa_classify_method, const char *, const char *,
                         const char *, uid_t, const char *, const char *, uint32_t,
                         const char *);
-static const char *streams_get_group(struct userdata *u, struct pa_classify_stream_def **, pa_proplist *,
-                                     const char *, uid_t, const char *, uint32_t *);
+static struct pa_policy_group *streams_get_group(struct userdata *u,
+                                                struct pa_classify_stream *,
+                                                pa_proplist *, const char *, uid_t,
+                                                const char *, uint32_t *,
+                                                pa_proplist **);
+static void streams_add_prop(struct pa_classify_stream *, const char *);
+static bool streams_def_matches(struct userdata *u, struct pa_classify_stream_def *,
+                                pa_proplist *, const uint32_t *, const char *,
+                                const char *, uid_t, const char *);
 static struct pa_classify_stream_def
             *streams_find(struct userdata *u, struct pa_classify_stream_def **, pa_proplist *,
                           const char *, const char *, uid_t, const char *,
                           struct pa_classify_stream_def **);
 
+static void streams_index_free(struct pa_classify_stream_index *);
+static void streams_index_add(struct pa_classify_stream_index *,
+                              struct pa_classify_stream_def *);
+static struct pa_classify_stream_def
+            *streams_index_find(struct userdata *u, struct pa_classify_stream_index *,
+                                pa_proplist *, const uint32_t *, const char *, uid_t,
+                                const char *);
+
+static void  client_cache_free(void *);
+static char *client_cache_key(struct pa_classify_stream *, pa_proplist *);
+static struct pa_classify_cache_entry
+            *client_cache_lookup(struct pa_classify_stream *, uint32_t, const char *);
+static void  client_cache_store(struct pa_classify_stream *, uint32_t, char *,
+                                struct pa_policy_group *, uint32_t, pa_proplist *);
+
 static void device_def_free(struct pa_classify_device_def *d);
 static void devices_free(struct pa_classify_device *);
 static void devices_add(struct userdata *u, struct pa_classify_device **p_devices, const char *type,
@@ -69,10 +93,17 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
                         enum pa_classify_method method, const char *arg,
                         pa_idxset *ports, const char *module, const char *module_args,
                         uint32_t flags, uint32_t port_change_delay);
-static int devices_classify(struct pa_classify_device *devices, const void *object,
+static void type_index_set(uint32_t **, uint32_t *, pa_policy_atom, int);
+static int devices_find_type(struct pa_classify_device *, const char *);
+static struct pa_classify_memo *devices_memo(struct pa_classify_device *,
+                                             struct pa_classify_memo **,
+                                             enum pa_policy_object_type, const void *);
+static int devices_classify(struct pa_classify_device *devices,
+                            struct pa_classify_memo *memo,
                             uint32_t flag_mask, uint32_t flag_value,
                             struct pa_classify_result **result);
-static int devices_is_typeof(struct pa_classify_device_def *defs, const void *object,
+static int devices_is_typeof(struct pa_classify_device *devices,
+                             struct pa_classify_memo *memo,
                              const char *type, struct pa_classify_device_data **data);
 
 static void card_def_free(struct pa_classify_card_def *d);
@@ -80,14 +111,17 @@ static void cards_free(struct pa_classify_card *);
 static void cards_add(struct userdata *u, struct pa_classify_card **, const char *,
                       enum pa_classify_method[PA_POLICY_CARD_MAX_DEFS], char **, char **,
                       uint32_t[PA_POLICY_CARD_MAX_DEFS]);
-static int  cards_classify(struct pa_classify_card *, pa_card *, pa_hashmap *card_profiles,
-                           uint32_t,uint32_t, bool reclassify, struct pa_classify_result **result);
-static int card_is_typeof(struct pa_classify_card_def *, pa_card *card,
+static int cards_find_type(struct pa_classify_card *, const char *);
+static struct pa_classify_memo *cards_memo(struct pa_classify_card *,
+                                           struct pa_classify_memo **, pa_card *);
+static int  cards_classify(struct pa_classify_card *, struct pa_classify_memo *,
+                           pa_hashmap *card_profiles, uint32_t,uint32_t,
+                           bool reclassify, struct pa_classify_result **result);
+static int card_is_typeof(struct pa_classify_card *, struct pa_classify_memo *,
                           const char *, struct pa_classify_card_data **, int *priority);
 
-static int port_device_is_typeof(struct pa_classify_device_def *,
-                                 enum pa_policy_object_type obj_type,
-                                 void *obj,
+static int port_device_is_typeof(struct pa_classify_device *,
+                                 struct pa_classify_memo *,
                                  const char *,
                                  struct pa_classify_device_data **);
 
@@ -111,6 +145,86 @@ static void classify_result_append(struct pa_classify_result **r, const char *ty
     (*r)->count++;
 }
 
+/* The match objects of a rule family are evaluated together through its
+ * match set. */
+static void classify_matches_add(pa_policy_match_set *set,
+                                 pa_policy_match_object *obj, uint32_t id)
+{
+    if (obj)
+        pa_policy_match_set_add(set, obj, id);
+}
+
+static bool classify_match(pa_policy_match_object *obj, const void *target,
+                           const uint32_t *matched, uint32_t id)
+{
+    if (matched)
+        return pa_policy_match_set_has(matched, id);
+
+    return pa_policy_match(obj, target);
+}
+
+/* Memos live in the extension of the classified object. Objects without
+ * an extension get a temporary one in '*tmp' that the caller frees. */
+static struct pa_classify_memo *sink_memo(struct userdata *u, struct pa_sink *sink,
+                                          struct pa_classify_memo **tmp)
+{
+    struct pa_sink_ext *ext = pa_sink_ext_lookup(u, sink);
+
+    *tmp = NULL;
+
+    return devices_memo(u->classify->sinks, ext ? &ext->memo : tmp,
+                        pa_policy_object_sink, sink);
+}
+
+static struct pa_classify_memo *source_memo(struct userdata *u, struct pa_source *source,
+                                            struct pa_classify_memo **tmp)
+{
+    struct pa_source_ext *ext = pa_source_ext_lookup(u, source);
+
+    *tmp = NULL;
+
+    return devices_memo(u->classify->sources, ext ? &ext->memo : tmp,
+                        pa_policy_object_source, source);
+}
+
+static struct pa_classify_memo *card_memo(struct userdata *u, struct pa_card *card,
+                                          struct pa_classify_memo **tmp)
+{
+    struct pa_card_ext *ext = pa_card_ext_lookup(u, card);
+
+    *tmp = NULL;
+
+    return cards_memo(u->classify->cards, ext ? &ext->memo : tmp, card);
+}
+
+void pa_classify_memo_free(struct pa_classify_memo *memo)
+{
+    if (memo) {
+        pa_xfree(memo->matched);
+        pa_xfree(memo->ports);
+        pa_xfree(memo);
+    }
+}
+
+/* Classification results of a client's streams, keyed by the values of
+ * the properties the stream and pid rules look at. Entries are valid only
+ * while their generation equals the stream classifier's generation. */
+#define CLIENT_CACHE_MAX 16
+
+struct pa_classify_cache_entry {
+    struct pa_classify_cache_entry *next;
+    uint32_t                        generation;
+    char                           *key;
+    struct pa_policy_group         *group;
+    uint32_t                        flags;
+    pa_proplist                    *properties;
+};
+
+struct pa_classify_client_cache {
+    struct pa_classify_cache_entry *entries;
+    uint32_t                        count;
+};
+
 static void unload_module(pa_module *m)
 {
     if (m) {
@@ -132,6 +246,11 @@ struct pa_classify *pa_classify_new(struct userdata *u)
     cl->sources = pa_xnew0(struct pa_classify_device, 1);
     cl->cards   = pa_xnew0(struct pa_classify_card, 1);
 
+    cl->streams.matches  = pa_policy_match_set_new();
+    cl->sinks->matches   = pa_policy_match_set_new();
+    cl->sources->matches = pa_policy_match_set_new();
+    cl->cards->matches   = pa_policy_match_set_new();
+
     return cl;
 }
 
@@ -143,6 +262,15 @@ void pa_classify_free(struct userdata *u)
     if (cl) {
         pid_hash_free_all(cl->streams.pid_hash);
         streams_free(cl->streams.defs);
+        streams_index_free(&cl->streams.index);
+        if (cl->streams.snames)
+            pa_hashmap_free(cl->streams.snames);
+        pa_xfree(cl->streams.sactive);
+        pa_policy_match_set_free(cl->streams.matches);
+        if (cl->streams.props)
+            pa_idxset_free(cl->streams.props, pa_xfree);
+        if (cl->streams.cache)
+            pa_hashmap_free(cl->streams.cache);
         devices_free(cl->sinks);
         devices_free(cl->sources);
         cards_free(cl->cards);
@@ -245,27 +373,106 @@ void pa_classify_add_stream(struct userdata *u, const char *prop,
             }
         }
 
-        streams_add(u, &classify->streams.defs, prop,method,arg,
+        streams_add(u, &classify->streams, prop,method,arg,
                     clnam, sname, uid, exe, grnam, flags, set_properties);
     }
 }
 
-void pa_classify_update_stream_route(struct userdata *u, const char *sname)
+/* Bind a group created after the configuration was read. */
+void pa_classify_bind_group(struct userdata *u, struct pa_policy_group *group)
 {
-    struct pa_classify_stream_def *stream;
+    struct pa_classify_stream_def *d;
+    struct pa_classify_pid_hash *st;
+    int i;
 
     pa_assert(u);
     pa_assert(u->classify);
+    pa_assert(group);
 
-    for (stream = u->classify->streams.defs;  stream;  stream = stream->next) {
-        if (stream->sname) {
-            if (pa_streq(stream->sname, sname))
-                stream->sact = 1;
-            else
-                stream->sact = 0;
-            pa_log_debug("stream group %s changes to %s state", stream->group, stream->sact ? "active" : "inactive");
+    for (d = u->classify->streams.defs;  d;  d = d->next) {
+        if (d->gatom == group->atom)
+            d->grp = group;
+    }
+
+    u->classify->streams.cache_generation++;
+
+    for (i = 0;  i < PA_POLICY_PID_HASH_MAX;  i++) {
+        for (st = u->classify->streams.pid_hash[i];  st;  st = st->next) {
+            if (!st->grp && pa_streq(st->group, group->name))
+                st->grp = group;
+        }
+    }
+}
+
+void pa_classify_bind_groups(struct userdata *u)
+{
+    struct pa_classify_stream_def *d;
+    struct pa_classify_pid_hash *st;
+    int i;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+
+    for (d = u->classify->streams.defs;  d;  d = d->next) {
+        if (!d->grp && !(d->grp = pa_policy_group_find_atom(u, d->gatom)))
+            pa_log("can't find group '%s' for stream", d->group);
+    }
+
+    for (i = 0;  i < PA_POLICY_PID_HASH_MAX;  i++) {
+        for (st = u->classify->streams.pid_hash[i];  st;  st = st->next) {
+            if (!st->grp)
+                st->grp = pa_policy_group_find(u, st->group);
         }
     }
+
+    u->classify->streams.cache_generation++;
+}
+
+static void streams_set_route(struct pa_classify_stream *streams,
+                              const char *sname, uid_t sact)
+{
+    struct pa_classify_stream_def *stream;
+
+    if (!sname || !streams->snames)
+        return;
+
+    stream = pa_hashmap_get(streams->snames, sname);
+
+    for (;  stream;  stream = stream->snext) {
+        stream->sact = sact;
+        pa_log_debug("stream group %s changes to %s state", stream->group,
+                     sact ? "active" : "inactive");
+    }
+}
+
+void pa_classify_update_stream_route(struct userdata *u, const char *sname)
+{
+    struct pa_classify_stream *streams;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+
+    streams = &u->classify->streams;
+
+    if (pa_safe_streq(streams->sactive, sname))
+        return;
+
+    streams_set_route(streams, streams->sactive, 0);
+    streams_set_route(streams, sname, 1);
+
+    pa_xfree(streams->sactive);
+    streams->sactive = pa_xstrdup(sname);
+
+    streams->cache_generation++;
+}
+
+/* The dynamic sink of some group started or stopped running. */
+void pa_classify_update_sink_activity(struct userdata *u)
+{
+    pa_assert(u);
+    pa_assert(u->classify);
+
+    u->classify->streams.cache_generation++;
 }
 
 void pa_classify_register_pid(struct userdata *u, pid_t pid, const char *prop,
@@ -278,8 +485,14 @@ void pa_classify_register_pid(struct userdata *u, pid_t pid, const char *prop,
     pa_assert_se((classify = u->classify));
 
     if (pid && group) {
-        pid_hash_insert(classify->streams.pid_hash, pid,
+        if (prop)
+            streams_add_prop(&classify->streams, prop);
+
+        pid_hash_insert(classify->streams.pid_hash,
+                        pa_policy_group_find(u, group), pid,
                         prop, method, arg, group);
+
+        classify->streams.cache_generation++;
     }
 }
 
@@ -293,14 +506,28 @@ void pa_classify_unregister_pid(struct userdata *u, pid_t pid, const char *prop,
 
     if (pid) {
         pid_hash_remove(classify->streams.pid_hash, pid, prop, method, arg);
+
+        classify->streams.cache_generation++;
     }
 }
 
-const char *pa_classify_sink_input(struct userdata *u, struct pa_sink_input *sinp,
-                                   uint32_t *flags)
+void pa_classify_forget_client(struct userdata *u, uint32_t idx)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+
+    if (classify->streams.cache)
+        pa_hashmap_remove_and_free(classify->streams.cache, PA_UINT32_TO_PTR(idx));
+}
+
+struct pa_policy_group *pa_classify_sink_input(struct userdata *u,
+                                               struct pa_sink_input *sinp,
+                                               uint32_t *flags)
 {
-    struct pa_client     *client;
-    const char           *group;
+    struct pa_client       *client;
+    struct pa_policy_group *group;
 
     pa_assert(u);
     pa_assert(sinp);
@@ -311,12 +538,12 @@ const char *pa_classify_sink_input(struct userdata *u, struct pa_sink_input *sin
     return group;
 }
 
-const char *pa_classify_sink_input_by_data(struct userdata *u,
-                                           struct pa_sink_input_new_data *data,
-                                           uint32_t *flags)
+struct pa_policy_group *pa_classify_sink_input_by_data(struct userdata *u,
+                                                       struct pa_sink_input_new_data *data,
+                                                       uint32_t *flags)
 {
-    struct pa_client     *client;
-    const char           *group;
+    struct pa_client       *client;
+    struct pa_policy_group *group;
 
     pa_assert(u);
     pa_assert(data);
@@ -327,33 +554,35 @@ const char *pa_classify_sink_input_by_data(struct userdata *u,
     return group;
 }
 
-const char *pa_classify_source_output(struct userdata *u,
-                                      struct pa_source_output *sout)
+struct pa_policy_group *pa_classify_source_output(struct userdata *u,
+                                                  struct pa_source_output *sout,
+                                                  uint32_t *flags)
 {
-    struct pa_client     *client;
-    const char           *group;
+    struct pa_client       *client;
+    struct pa_policy_group *group;
 
     pa_assert(u);
     pa_assert(sout);
 
     client = sout->client;
-    group  = find_group_for_client(u, client, sout->proplist, NULL);
+    group  = find_group_for_client(u, client, sout->proplist, flags);
 
     return group;
 }
 
-const char *
+struct pa_policy_group *
 pa_classify_source_output_by_data(struct userdata *u,
-                                  struct pa_source_output_new_data *data)
+                                  struct pa_source_output_new_data *data,
+                                  uint32_t *flags)
 {
-    struct pa_client     *client;
-    const char           *group;
+    struct pa_client       *client;
+    struct pa_policy_group *group;
 
     pa_assert(u);
     pa_assert(data);
 
     client = data->client;
-    group  = find_group_for_client(u, client, data->proplist, NULL);
+    group  = find_group_for_client(u, client, data->proplist, flags);
 
     return group;
 }
@@ -364,6 +593,8 @@ int pa_classify_sink(struct userdata *u, struct pa_sink *sink,
 {
     struct pa_classify *classify;
     struct pa_classify_device *devices;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
@@ -371,8 +602,11 @@ int pa_classify_sink(struct userdata *u, struct pa_sink *sink,
     pa_assert_se((devices = classify->sinks));
     pa_assert(result);
 
-    return devices_classify(devices, sink,
-                            flag_mask, flag_value, result);
+    ret = devices_classify(devices, sink_memo(u, sink, &tmp),
+                           flag_mask, flag_value, result);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 int pa_classify_source(struct userdata *u, struct pa_source *source,
@@ -381,6 +615,8 @@ int pa_classify_source(struct userdata *u, struct pa_source *source,
 {
     struct pa_classify *classify;
     struct pa_classify_device *devices;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
@@ -388,8 +624,11 @@ int pa_classify_source(struct userdata *u, struct pa_source *source,
     pa_assert_se((devices = classify->sources));
     pa_assert(result);
 
-    return devices_classify(devices, source,
-                            flag_mask, flag_value, result);
+    ret = devices_classify(devices, source_memo(u, source, &tmp),
+                           flag_mask, flag_value, result);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 int pa_classify_card(struct userdata *u, struct pa_card *card,
@@ -398,7 +637,9 @@ int pa_classify_card(struct userdata *u, struct pa_card *card,
 {
     struct pa_classify *classify;
     struct pa_classify_card *cards;
+    struct pa_classify_memo *tmp;
     pa_hashmap *profs;
+    int ret;
 
     pa_assert(u);
     pa_assert(result);
@@ -408,7 +649,11 @@ int pa_classify_card(struct userdata *u, struct pa_card *card,
 
     profs = pa_card_ext_get_profiles(card);
 
-    return cards_classify(cards, card, profs, flag_mask,flag_value, reclassify, result);
+    ret = cards_classify(cards, card_memo(u, card, &tmp), profs,
+                         flag_mask,flag_value, reclassify, result);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 int pa_classify_card_all_types(struct userdata *u,
@@ -484,17 +729,20 @@ int pa_classify_is_sink_typeof(struct userdata *u, struct pa_sink *sink,
                                struct pa_classify_device_data **d)
 {
     struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->sinks);
-    pa_assert_se((defs = classify->sinks->defs));
 
     if (!sink || !type)
         return false;
 
-    return devices_is_typeof(defs, sink, type, d);
+    ret = devices_is_typeof(classify->sinks, sink_memo(u, sink, &tmp), type, d);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 
@@ -503,17 +751,20 @@ int pa_classify_is_source_typeof(struct userdata *u, struct pa_source *source,
                                  struct pa_classify_device_data **d)
 {
     struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->sources);
-    pa_assert_se((defs = classify->sources->defs));
 
     if (!source || !type)
         return false;
 
-    return devices_is_typeof(defs, source, type, d);
+    ret = devices_is_typeof(classify->sources, source_memo(u, source, &tmp), type, d);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 
@@ -521,17 +772,20 @@ int pa_classify_is_card_typeof(struct userdata *u, struct pa_card *card,
                                const char *type, struct pa_classify_card_data **d, int *priority)
 {
     struct pa_classify *classify;
-    struct pa_classify_card_def *defs;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->cards);
-    pa_assert_se((defs = classify->cards->defs));
 
     if (!card || !type)
         return false;
 
-    return card_is_typeof(defs, card, type, d, priority);
+    ret = card_is_typeof(classify->cards, card_memo(u, card, &tmp), type, d, priority);
+    pa_classify_memo_free(tmp);
+
+    return ret;
 }
 
 
@@ -540,37 +794,345 @@ int pa_classify_is_port_sink_typeof(struct userdata *u, struct pa_sink *sink,
                                     struct pa_classify_device_data **d)
 {
     struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
+    struct pa_classify_memo *tmp;
+    int ret;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->sinks);
-    pa_assert_se((defs = classify->sinks->defs));
 
     if (!sink || !type)
         return false;
 
-    return port_device_is_typeof(defs, pa_policy_object_sink, sink, type, d);
-}
+    ret = port_device_is_typeof(classify->sinks, sink_memo(u, sink, &tmp), type, d);
+    pa_classify_memo_free(tmp);
+
+    return ret;
+}
+
+
+int pa_classify_is_port_source_typeof(struct userdata *u,
+                                      struct pa_source *source,
+                                      const char *type,
+                                      struct pa_classify_device_data **d)
+{
+    struct pa_classify *classify;
+    struct pa_classify_memo *tmp;
+    int ret;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(classify->sources);
+
+    if (!source || !type)
+        return false;
+
+    ret = port_device_is_typeof(classify->sources, source_memo(u, source, &tmp), type, d);
+    pa_classify_memo_free(tmp);
+
+    return ret;
+}
+
+/*
+ * Type => object index. Every device definition (and every set of a card
+ * definition) keeps the objects that are of its type. Objects are added
+ * when they are put and removed when they are unlinked or their
+ * properties change. If the definitions change after that the index is
+ * rebuilt when it is used next time.
+ */
+static void devices_index_add(struct pa_classify_device *devices,
+                              struct pa_classify_memo *memo, void *obj)
+{
+    struct pa_classify_device_def *d;
+
+    for (d = devices->defs;  d->type;  d++) {
+        if (memo->matched[d - devices->defs]) {
+            if (!d->objects)
+                d->objects = pa_idxset_new(NULL, NULL);
+            pa_idxset_put(d->objects, obj, NULL);
+        }
+    }
+}
+
+static void devices_index_remove(struct pa_classify_device *devices, void *obj)
+{
+    struct pa_classify_device_def *d;
+
+    for (d = devices->defs;  d->type;  d++) {
+        if (d->objects)
+            pa_idxset_remove_by_data(d->objects, obj, NULL);
+    }
+}
+
+static pa_idxset *devices_index_get(struct pa_classify_device *devices,
+                                    const char *type)
+{
+    int i;
+
+    if ((i = devices_find_type(devices, type)) < 0)
+        return NULL;
+
+    return devices->defs[i].objects;
+}
+
+static void sinks_index_rebuild(struct userdata *u)
+{
+    struct pa_classify_device *devices = u->classify->sinks;
+    struct pa_classify_memo *tmp;
+    struct pa_sink *sink;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
+        devices_index_remove(devices, sink);
+
+        if (pa_sink_ext_lookup(u, sink))
+            devices_index_add(devices, sink_memo(u, sink, &tmp), sink);
+    }
+
+    devices->index_generation = devices->generation;
+}
+
+static void sources_index_rebuild(struct userdata *u)
+{
+    struct pa_classify_device *devices = u->classify->sources;
+    struct pa_classify_memo *tmp;
+    struct pa_source *source;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(source, u->core->sources, idx) {
+        devices_index_remove(devices, source);
+
+        if (pa_source_ext_lookup(u, source))
+            devices_index_add(devices, source_memo(u, source, &tmp), source);
+    }
+
+    devices->index_generation = devices->generation;
+}
+
+void pa_classify_register_sink(struct userdata *u, struct pa_sink *sink)
+{
+    struct pa_classify_device *devices;
+    struct pa_classify_memo *tmp;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((devices = u->classify->sinks));
+    pa_assert(sink);
+
+    if (devices->index_generation != devices->generation)
+        sinks_index_rebuild(u);
+    else {
+        devices_index_add(devices, sink_memo(u, sink, &tmp), sink);
+        pa_classify_memo_free(tmp);
+    }
+}
+
+void pa_classify_unregister_sink(struct userdata *u, struct pa_sink *sink)
+{
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert(sink);
+
+    devices_index_remove(u->classify->sinks, sink);
+}
+
+struct pa_sink *pa_classify_find_sink(struct userdata *u, const char *type)
+{
+    struct pa_classify_device *devices;
+    pa_idxset *objects;
+    struct pa_sink *sink;
+    struct pa_sink *found = NULL;
+    uint32_t idx;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((devices = u->classify->sinks));
+    pa_assert(type);
+
+    if (devices->index_generation != devices->generation)
+        sinks_index_rebuild(u);
+
+    /* the first one in the core's list wins */
+    if ((objects = devices_index_get(devices, type)) != NULL) {
+        PA_IDXSET_FOREACH(sink, objects, idx) {
+            if (!found || sink->index < found->index)
+                found = sink;
+        }
+    }
+
+    return found;
+}
+
+void pa_classify_register_source(struct userdata *u, struct pa_source *source)
+{
+    struct pa_classify_device *devices;
+    struct pa_classify_memo *tmp;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((devices = u->classify->sources));
+    pa_assert(source);
+
+    if (devices->index_generation != devices->generation)
+        sources_index_rebuild(u);
+    else {
+        devices_index_add(devices, source_memo(u, source, &tmp), source);
+        pa_classify_memo_free(tmp);
+    }
+}
+
+void pa_classify_unregister_source(struct userdata *u, struct pa_source *source)
+{
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert(source);
+
+    devices_index_remove(u->classify->sources, source);
+}
+
+struct pa_source *pa_classify_find_source(struct userdata *u, const char *type)
+{
+    struct pa_classify_device *devices;
+    pa_idxset *objects;
+    struct pa_source *source;
+    struct pa_source *found = NULL;
+    uint32_t idx;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((devices = u->classify->sources));
+    pa_assert(type);
+
+    if (devices->index_generation != devices->generation)
+        sources_index_rebuild(u);
+
+    /* the first one in the core's list wins */
+    if ((objects = devices_index_get(devices, type)) != NULL) {
+        PA_IDXSET_FOREACH(source, objects, idx) {
+            if (!found || source->index < found->index)
+                found = source;
+        }
+    }
+
+    return found;
+}
+
+/* A card is indexed only under the first set of a definition it matches,
+ * the same one pa_classify_is_card_typeof() would report. */
+static void cards_index_add(struct pa_classify_card *cards,
+                            struct pa_classify_memo *memo, pa_card *card)
+{
+    struct pa_classify_card_def *d;
+    struct pa_classify_card_data *data;
+    int i;
+
+    for (d = cards->defs;  d->type;  d++) {
+        for (i = 0; i < PA_POLICY_CARD_MAX_DEFS && d->data[i].profile; i++) {
+            if (memo->matched[(d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i]) {
+                data = &d->data[i];
+                if (!data->objects)
+                    data->objects = pa_idxset_new(NULL, NULL);
+                pa_idxset_put(data->objects, card, NULL);
+                break;
+            }
+        }
+    }
+}
+
+static void cards_index_remove(struct pa_classify_card *cards, pa_card *card)
+{
+    struct pa_classify_card_def *d;
+    int i;
+
+    for (d = cards->defs;  d->type;  d++) {
+        for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++) {
+            if (d->data[i].objects)
+                pa_idxset_remove_by_data(d->data[i].objects, card, NULL);
+        }
+    }
+}
+
+static void cards_index_rebuild(struct userdata *u)
+{
+    struct pa_classify_card *cards = u->classify->cards;
+    struct pa_classify_memo *tmp;
+    pa_card *card;
+    uint32_t idx;
+
+    PA_IDXSET_FOREACH(card, u->core->cards, idx) {
+        cards_index_remove(cards, card);
+
+        if (pa_card_ext_lookup(u, card))
+            cards_index_add(cards, card_memo(u, card, &tmp), card);
+    }
+
+    cards->index_generation = cards->generation;
+}
+
+void pa_classify_register_card(struct userdata *u, struct pa_card *card)
+{
+    struct pa_classify_card *cards;
+    struct pa_classify_memo *tmp;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((cards = u->classify->cards));
+    pa_assert(card);
+
+    if (cards->index_generation != cards->generation)
+        cards_index_rebuild(u);
+    else {
+        cards_index_add(cards, card_memo(u, card, &tmp), card);
+        pa_classify_memo_free(tmp);
+    }
+}
+
+void pa_classify_unregister_card(struct userdata *u, struct pa_card *card)
+{
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert(card);
+
+    cards_index_remove(u->classify->cards, card);
+}
+
+struct pa_card *pa_classify_find_card(struct userdata *u, const char *type,
+                                      int priority,
+                                      struct pa_classify_card_data **data)
+{
+    struct pa_classify_card *cards;
+    struct pa_classify_card_data *cd;
+    pa_card *card;
+    pa_card *found = NULL;
+    uint32_t idx;
+    int i;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert_se((cards = u->classify->cards));
+    pa_assert(type);
+    pa_assert(priority >= 0 && priority < PA_POLICY_CARD_MAX_DEFS);
 
+    if (cards->index_generation != cards->generation)
+        cards_index_rebuild(u);
 
-int pa_classify_is_port_source_typeof(struct userdata *u,
-                                      struct pa_source *source,
-                                      const char *type,
-                                      struct pa_classify_device_data **d)
-{
-    struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
+    if ((i = cards_find_type(cards, type)) < 0)
+        return NULL;
 
-    pa_assert(u);
-    pa_assert_se((classify = u->classify));
-    pa_assert(classify->sources);
-    pa_assert_se((defs = classify->sources->defs));
+    cd = &cards->defs[i].data[priority];
 
-    if (!source || !type)
-        return false;
+    /* the last one in the core's list wins */
+    if (cd->objects) {
+        PA_IDXSET_FOREACH(card, cd->objects, idx) {
+            if (!found || card->index > found->index)
+                found = card;
+        }
+    }
 
-    return port_device_is_typeof(defs, pa_policy_object_source, source, type, d);
+    if (found && data)
+        *data = cd;
+
+    return found;
 }
 
 
@@ -728,26 +1290,32 @@ static pa_hook_result_t module_unlink_hook_cb(pa_core *c, pa_module *m, struct p
 }
 
 
-static const char *find_group_for_client(struct userdata  *u,
-                                         struct pa_client *client,
-                                         pa_proplist      *proplist,
-                                         uint32_t         *flags_ret)
+/* Return the group of the stream, the default group if no definition
+ * matches. */
+static struct pa_policy_group *find_group_for_client(struct userdata  *u,
+                                                    struct pa_client *client,
+                                                    pa_proplist      *proplist,
+                                                    uint32_t         *flags_ret)
 {
     struct pa_classify *classify;
     struct pa_classify_pid_hash **hash;
-    struct pa_classify_stream_def **defs;
+    struct pa_classify_stream *streams;
+    struct pa_classify_cache_entry *cached = NULL;
+    struct pa_client_ext *ext;
     pid_t       pid   = 0;          /* client processs PID */
     const char *clnam = "";         /* client's name in PA */
     uid_t       uid   = (uid_t) -1; /* client process user ID */
     const char *exe   = "";         /* client's binary path */
-    const char *group = NULL;
+    struct pa_policy_group *group = NULL;
     uint32_t  flags = 0;
+    pa_proplist *properties = NULL;
+    char       *key;
 
     assert(u);
     pa_assert_se((classify = u->classify));
 
-    hash = classify->streams.pid_hash;
-    defs = &classify->streams.defs;
+    hash    = classify->streams.pid_hash;
+    streams = &classify->streams;
 
     if (client == NULL) {
         /* sample cache initiated sink-inputs don't have a client, but sample's proplist
@@ -757,25 +1325,47 @@ static const char *find_group_for_client(struct userdata  *u,
         if (!(exe = pa_proplist_gets(proplist, PA_PROP_APPLICATION_PROCESS_BINARY)))
             exe = "";
 
-        group = streams_get_group(u, defs, proplist, clnam, uid, exe, &flags);
+        group = streams_get_group(u, streams, proplist, clnam, uid, exe, &flags,
+                                  &properties);
     } else {
-        pid = pa_client_ext_pid(client);
+        key = client_cache_key(streams, proplist);
+
+        if ((cached = client_cache_lookup(streams, client->index, key))) {
+            group = cached->group;
+            flags = cached->flags;
+
+            if (cached->properties)
+                pa_proplist_update(proplist, PA_UPDATE_REPLACE, cached->properties);
+
+            pa_xfree(key);
+        }
+        else {
+            ext = pa_client_ext_lookup(u, client);
+            pid = ext->pid;
 
-        if ((group = pid_hash_get_group(hash, pid, proplist)) == NULL) {
-            clnam = pa_client_ext_name(client);
-            uid   = pa_client_ext_uid(client);
-            exe   = pa_client_ext_exe(client);
+            if ((group = pid_hash_get_group(hash, pid, proplist)) == NULL) {
+                clnam = ext->name;
+                uid   = ext->uid;
+                exe   = ext->exe;
 
-            group = streams_get_group(u, defs, proplist, clnam, uid, exe, &flags);
+                group = streams_get_group(u, streams, proplist, clnam, uid, exe, &flags,
+                                          &properties);
+            }
+
+            client_cache_store(streams, client->index, key, group, flags, properties);
         }
     }
 
     if (group == NULL)
-        group = PA_POLICY_DEFAULT_GROUP_NAME;
+        group = u->groups->dflt;
 
-    pa_log_debug("%s (%s|%d|%d|%s) => %s,0x%x", __FUNCTION__,
-                 clnam?clnam:"<null>", pid, uid, exe?exe:"<null>",
-                 group?group:"<null>", flags);
+    if (cached)
+        pa_log_debug("%s (client %u) => %s,0x%x (cached)", __FUNCTION__,
+                     client->index, group ? group->name : "<null>", flags);
+    else
+        pa_log_debug("%s (%s|%d|%d|%s) => %s,0x%x", __FUNCTION__,
+                     clnam?clnam:"<null>", pid, uid, exe?exe:"<null>",
+                     group ? group->name : "<null>", flags);
 
     if (flags_ret != NULL)
         *flags_ret = flags;
@@ -833,7 +1423,8 @@ static void pid_hash_free_all(struct pa_classify_pid_hash **hash)
     }
 }
 
-static void pid_hash_insert(struct pa_classify_pid_hash **hash, pid_t pid,
+static void pid_hash_insert(struct pa_classify_pid_hash **hash,
+                            struct pa_policy_group *grp, pid_t pid,
                             const char *prop, enum pa_classify_method method,
                             const char *arg, const char *group)
 {
@@ -854,6 +1445,7 @@ static void pid_hash_insert(struct pa_classify_pid_hash **hash, pid_t pid,
                                                                 group);
         pa_xfree(st->group);
         st->group = pa_xstrdup(group);
+        st->grp   = grp;
     }
     else {
         st  = pa_xnew0(struct pa_classify_pid_hash, 1);
@@ -861,6 +1453,7 @@ static void pid_hash_insert(struct pa_classify_pid_hash **hash, pid_t pid,
         st->next  = prev->next;
         st->pid   = pid;
         st->group = pa_xstrdup(group);
+        st->grp   = grp;
 
         if (prop) {
             st->pid_match = pa_policy_match_property_new(pa_policy_object_proplist,
@@ -901,12 +1494,12 @@ static void pid_hash_remove(struct pa_classify_pid_hash **hash,
     }
 }
 
-static char *pid_hash_get_group(struct pa_classify_pid_hash **hash,
-                                pid_t pid, pa_proplist *proplist)
+static struct pa_policy_group *pid_hash_get_group(struct pa_classify_pid_hash **hash,
+                                                 pid_t pid, pa_proplist *proplist)
 {
     struct pa_classify_pid_hash *st;
     int idx;
-    char *group = NULL;
+    struct pa_policy_group *group = NULL;
 
     pa_assert(hash);
  
@@ -915,13 +1508,8 @@ static char *pid_hash_get_group(struct pa_classify_pid_hash **hash,
 
         for (st = hash[idx];  st != NULL;  st = st->next) {
             if (pid == st->pid) {
-                if (!st->pid_match) {
-                    group = st->group;
-                    break;
-                }
-
-                if (pa_policy_match(st->pid_match, proplist)) {
-                    group = st->group;
+                if (!st->pid_match || pa_policy_match(st->pid_match, proplist)) {
+                    group = st->grp;
                     break;
                 }
             }
@@ -993,19 +1581,23 @@ static void streams_free(struct pa_classify_stream_def *defs)
     }
 }
 
-static void streams_add(struct userdata *u, struct pa_classify_stream_def **defs, const char *prop,
+static void streams_add(struct userdata *u, struct pa_classify_stream *streams, const char *prop,
                         enum pa_classify_method method, const char *arg, const char *clnam,
                         const char *sname, uid_t uid, const char *exe, const char *group, uint32_t flags,
                         const char *set_properties)
 {
+    struct pa_classify_stream_def **defs;
     struct pa_classify_stream_def *d;
     struct pa_classify_stream_def *prev;
+    struct pa_classify_stream_def *first;
     pa_proplist *proplist = NULL;
     char        *method_def = NULL;
 
-    pa_assert(defs);
+    pa_assert(streams);
     pa_assert(group);
 
+    defs = &streams->defs;
+
     proplist = pa_proplist_new();
 
     if (prop && arg && (method == pa_method_equals)) {
@@ -1031,86 +1623,150 @@ static void streams_add(struct userdata *u, struct pa_classify_stream_def **defs
             }
 
             method_def = pa_policy_match_def(d->stream_match);
+
+            streams_add_prop(streams, prop);
         }
 
         d->uid          = uid;
         d->exe          = exe   ? pa_xstrdup(exe)   : NULL;
         d->clnam        = clnam ? pa_xstrdup(clnam) : NULL;
         d->sname        = sname ? pa_xstrdup(sname) : NULL;
-        d->sact         = sname ? 0 : -1;
+        d->sact         = sname ? pa_safe_streq(sname, streams->sactive) : -1;
         /* Stream action, identified streams' proplists are merged with what's defined here. */
         d->properties   = set_properties ? pa_proplist_from_string(set_properties) : NULL;
+        d->seq          = streams->ndef++;
 
         prev->next = d;
 
+        streams_index_add(&streams->index, d);
+
+        if (sname) {
+            if (!streams->snames)
+                streams->snames = pa_hashmap_new(pa_idxset_string_hash_func,
+                                                  pa_idxset_string_compare_func);
+
+            if ((first = pa_hashmap_get(streams->snames, d->sname))) {
+                while (first->snext)
+                    first = first->snext;
+                first->snext = d;
+            }
+            else
+                pa_hashmap_put(streams->snames, d->sname, d);
+        }
+        classify_matches_add(streams->matches, d->stream_match, d->seq);
+
         pa_log_debug("stream added (%d|%s|%s|%s|%d)", uid, exe?exe:"<null>",
                      clnam?clnam:"<null>", method_def, d->sact);
     }
 
     d->group = pa_xstrdup(group);
+    d->gatom = pa_policy_atom_intern(group);
+    d->grp   = pa_policy_group_find_atom(u, d->gatom);
     d->flags = flags;
 
+    streams->cache_generation++;
+
     pa_proplist_free(proplist);
     pa_xfree(method_def);
 }
 
-static const char *streams_get_group(struct userdata *u,
-                                     struct pa_classify_stream_def **defs,
-                                     pa_proplist *proplist,
-                                     const char *clnam, uid_t uid, const char *exe,
-                                     uint32_t *flags_ret)
+static struct pa_policy_group *streams_get_group(struct userdata *u,
+                                                struct pa_classify_stream *streams,
+                                                pa_proplist *proplist,
+                                                const char *clnam, uid_t uid,
+                                                const char *exe, uint32_t *flags_ret,
+                                                pa_proplist **properties_ret)
 {
     struct pa_classify_stream_def *d;
-    const char *group;
+    const uint32_t *matched;
+    struct pa_policy_group *group;
     uint32_t flags;
 
-    pa_assert(defs);
+    pa_assert(streams);
+
+    matched = pa_policy_match_set_run(streams->matches, proplist);
 
-    if ((d = streams_find(u, defs, proplist, clnam, NULL, uid, exe, NULL)) == NULL) {
+    d = streams_index_find(u, &streams->index, proplist, matched, clnam, uid, exe);
+
+    if (d == NULL) {
         group = NULL;
         flags = 0;
     }
     else {
-        group = d->group;
+        group = d->grp;
         flags = d->flags;
     }
 
     if (flags_ret != NULL)
         *flags_ret = flags;
 
+    if (properties_ret != NULL)
+        *properties_ret = d ? d->properties : NULL;
+
     if (d && d->properties)
         pa_proplist_update(proplist, PA_UPDATE_REPLACE, d->properties);
 
     return group;
 }
 
-static bool group_sink_is_active(struct userdata *u, const char *group_name)
+static void streams_add_prop(struct pa_classify_stream *streams, const char *prop)
 {
-    struct pa_policy_group *group;
-    pa_sink *sink;
+    pa_assert(streams);
+    pa_assert(prop);
+
+    if (!streams->props)
+        streams->props = pa_idxset_new(pa_idxset_string_hash_func,
+                                       pa_idxset_string_compare_func);
+
+    if (!pa_idxset_get_by_data(streams->props, prop, NULL)) {
+        pa_idxset_put(streams->props, pa_xstrdup(prop), NULL);
+        streams->cache_generation++;
+    }
+}
 
-    if ((group = pa_policy_group_find(u, group_name))) {
+/* The activity of dynamic sinks is kept up to date by the groupset, which
+ * also invalidates the stream cache whenever it changes. */
+static bool group_sink_is_active(struct pa_policy_group *group)
+{
+    if (group) {
         if (!(group->flags & PA_POLICY_GROUP_FLAG_DYNAMIC_SINK))
             return true;
 
-        if ((sink = pa_policy_group_find_sink(u, group))) {
-            pa_log_debug("sink %s is %srunning", sink->name, sink->state == PA_SINK_RUNNING ? "" : "not ");
-            return sink->state == PA_SINK_RUNNING;
-        }
+        return group->sinkact;
     }
 
     return false;
 }
 
+static bool streams_def_matches(struct userdata *u, struct pa_classify_stream_def *d,
+                                pa_proplist *proplist, const uint32_t *matched,
+                                const char *clnam, const char *sname, uid_t uid,
+                                const char *exe)
+{
+#define PROPERTY_MATCH     (!d->stream_match || classify_match(d->stream_match, proplist, \
+                                                               matched, d->seq))
+#define STRING_MATCH_OF(m) (!d->m || (m && d->m && !strcmp(m, d->m)))
+#define ID_MATCH_OF(m)     (d->m == -1 || m == d->m)
+
+    return PROPERTY_MATCH         &&
+           STRING_MATCH_OF(clnam) &&
+           ID_MATCH_OF(uid)       &&
+           /* case for dynamically changing active sink. */
+           (!sname || (sname && d->sname && !strcmp(sname, d->sname))) &&
+           ((d->sact == -1 || d->sact == 1) && group_sink_is_active(d->grp)) &&
+           /* end special case */
+           STRING_MATCH_OF(exe);
+
+#undef PROPERTY_MATCH
+#undef STRING_MATCH_OF
+#undef ID_MATCH_OF
+}
+
 static struct pa_classify_stream_def *
 streams_find(struct userdata *u, struct pa_classify_stream_def **defs, pa_proplist *proplist,
              const char *clnam, const char *sname, uid_t uid, const char *exe,
              struct pa_classify_stream_def **prev_ret)
 {
-#define PROPERTY_MATCH     (!d->stream_match || pa_policy_match(d->stream_match, proplist))
-#define STRING_MATCH_OF(m) (!d->m || (m && d->m && !strcmp(m, d->m)))
-#define ID_MATCH_OF(m)     (d->m == -1 || m == d->m)
-
     struct pa_classify_stream_def *prev;
     struct pa_classify_stream_def *d;
 
@@ -1118,16 +1774,8 @@ streams_find(struct userdata *u, struct pa_classify_stream_def **defs, pa_propli
          (d = prev->next) != NULL;
          prev = prev->next)
     {
-        if (PROPERTY_MATCH         &&
-            STRING_MATCH_OF(clnam) &&
-            ID_MATCH_OF(uid)       &&
-            /* case for dynamically changing active sink. */
-            (!sname || (sname && d->sname && !strcmp(sname, d->sname))) &&
-            ((d->sact == -1 || d->sact == 1) && group_sink_is_active(u, d->group)) &&
-            /* end special case */
-            STRING_MATCH_OF(exe)      )
+        if (streams_def_matches(u, d, proplist, NULL, clnam, sname, uid, exe))
             break;
-
     }
 
     if (prev_ret)
@@ -1143,10 +1791,274 @@ streams_find(struct userdata *u, struct pa_classify_stream_def **defs, pa_propli
 #endif
 
     return d;
+}
 
-#undef PROPERTY_MATCH
-#undef STRING_MATCH_OF
-#undef ID_MATCH_OF
+static struct pa_classify_stream_bucket *streams_bucket(pa_hashmap **map,
+                                                        const char *key,
+                                                        bool create)
+{
+    struct pa_classify_stream_bucket *bucket;
+
+    pa_assert(map);
+    pa_assert(key);
+
+    if (!*map) {
+        if (!create)
+            return NULL;
+
+        *map = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                   pa_idxset_string_compare_func,
+                                   pa_xfree,
+                                   pa_xfree);
+    }
+
+    if (!(bucket = pa_hashmap_get(*map, key)) && create) {
+        bucket = pa_xnew0(struct pa_classify_stream_bucket, 1);
+        pa_hashmap_put(*map, pa_xstrdup(key), bucket);
+    }
+
+    return bucket;
+}
+
+static void streams_index_free(struct pa_classify_stream_index *index)
+{
+    pa_assert(index);
+
+    if (index->exe)
+        pa_hashmap_free(index->exe);
+    if (index->clnam)
+        pa_hashmap_free(index->clnam);
+    if (index->uid)
+        pa_hashmap_free(index->uid);
+    if (index->props)
+        pa_hashmap_free(index->props);
+
+    memset(index, 0, sizeof(*index));
+}
+
+static void streams_index_add(struct pa_classify_stream_index *index,
+                              struct pa_classify_stream_def *d)
+{
+    struct pa_classify_stream_bucket *bucket;
+    pa_policy_match_object *match;
+    pa_hashmap *values;
+    char uidstr[16];
+
+    pa_assert(index);
+    pa_assert(d);
+
+    match = d->stream_match;
+
+    if (d->exe)
+        bucket = streams_bucket(&index->exe, d->exe, true);
+    else if (d->clnam)
+        bucket = streams_bucket(&index->clnam, d->clnam, true);
+    else if (match && pa_policy_match_method(match) == pa_method_equals) {
+        if (!index->props)
+            index->props = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                               pa_idxset_string_compare_func,
+                                               pa_xfree,
+                                               (pa_free_cb_t) pa_hashmap_free);
+
+        if ((values = pa_hashmap_get(index->props, match->target_def)))
+            bucket = streams_bucket(&values, pa_policy_match_arg(match), true);
+        else {
+            bucket = streams_bucket(&values, pa_policy_match_arg(match), true);
+            pa_hashmap_put(index->props, pa_xstrdup(match->target_def), values);
+        }
+    }
+    else if (d->uid != (uid_t) -1) {
+        snprintf(uidstr, sizeof(uidstr), "%u", (unsigned) d->uid);
+        bucket = streams_bucket(&index->uid, uidstr, true);
+    }
+    else
+        bucket = &index->any;
+
+    d->inext = NULL;
+
+    if (bucket->last)
+        bucket->last->inext = d;
+    else
+        bucket->first = d;
+
+    bucket->last = d;
+}
+
+/* Returns the first matching def of the bucket if it precedes 'best' in
+ * configuration order, otherwise 'best'. */
+static struct pa_classify_stream_def *
+streams_bucket_find(struct userdata *u, struct pa_classify_stream_bucket *bucket,
+                    struct pa_classify_stream_def *best, pa_proplist *proplist,
+                    const uint32_t *matched, const char *clnam, uid_t uid,
+                    const char *exe)
+{
+    struct pa_classify_stream_def *d;
+
+    if (bucket) {
+        for (d = bucket->first;  d && (!best || d->seq < best->seq);  d = d->inext) {
+            if (streams_def_matches(u, d, proplist, matched, clnam, NULL, uid, exe))
+                return d;
+        }
+    }
+
+    return best;
+}
+
+/* Same result as streams_find() without an sname, but evaluates only the
+ * defs that can match the given client and proplist. */
+static struct pa_classify_stream_def *
+streams_index_find(struct userdata *u, struct pa_classify_stream_index *index,
+                   pa_proplist *proplist, const uint32_t *matched, const char *clnam,
+                   uid_t uid, const char *exe)
+{
+    struct pa_classify_stream_def *best = NULL;
+    pa_hashmap *values;
+    const void *prop;
+    const char *value;
+    void *state = NULL;
+    char uidstr[16];
+
+    pa_assert(index);
+
+    if (exe && index->exe)
+        best = streams_bucket_find(u, streams_bucket(&index->exe, exe, false),
+                                   best, proplist, matched, clnam, uid, exe);
+
+    if (clnam && index->clnam)
+        best = streams_bucket_find(u, streams_bucket(&index->clnam, clnam, false),
+                                   best, proplist, matched, clnam, uid, exe);
+
+    if (proplist && index->props) {
+        while ((values = pa_hashmap_iterate(index->props, &state, &prop))) {
+            if ((value = pa_proplist_gets(proplist, prop)))
+                best = streams_bucket_find(u, streams_bucket(&values, value, false),
+                                           best, proplist, matched, clnam, uid, exe);
+        }
+    }
+
+    if (uid != (uid_t) -1 && index->uid) {
+        snprintf(uidstr, sizeof(uidstr), "%u", (unsigned) uid);
+        best = streams_bucket_find(u, streams_bucket(&index->uid, uidstr, false),
+                                   best, proplist, matched, clnam, uid, exe);
+    }
+
+    return streams_bucket_find(u, &index->any, best, proplist, matched, clnam, uid, exe);
+}
+
+static void client_cache_free(void *data)
+{
+    struct pa_classify_client_cache *cache = data;
+    struct pa_classify_cache_entry *entry;
+
+    pa_assert(cache);
+
+    while ((entry = cache->entries) != NULL) {
+        cache->entries = entry->next;
+        pa_xfree(entry->key);
+        pa_xfree(entry);
+    }
+
+    pa_xfree(cache);
+}
+
+static char *client_cache_key(struct pa_classify_stream *streams, pa_proplist *proplist)
+{
+    pa_strbuf  *buf;
+    const char *prop;
+    const char *value;
+    uint32_t    idx;
+
+    pa_assert(streams);
+
+    buf = pa_strbuf_new();
+
+    if (streams->props && proplist) {
+        PA_IDXSET_FOREACH(prop, streams->props, idx) {
+            if ((value = pa_proplist_gets(proplist, prop)))
+                pa_strbuf_printf(buf, "%u:%s", (unsigned) strlen(value), value);
+            else
+                pa_strbuf_putc(buf, '-');
+        }
+    }
+
+#if (PULSEAUDIO_VERSION >= 8)
+    return pa_strbuf_to_string_free(buf);
+#else
+    return pa_strbuf_tostring_free(buf);
+#endif
+}
+
+static struct pa_classify_cache_entry *
+client_cache_lookup(struct pa_classify_stream *streams, uint32_t client_idx,
+                    const char *key)
+{
+    struct pa_classify_client_cache *cache;
+    struct pa_classify_cache_entry *entry;
+
+    pa_assert(streams);
+    pa_assert(key);
+
+    if (!streams->cache ||
+        !(cache = pa_hashmap_get(streams->cache, PA_UINT32_TO_PTR(client_idx))))
+        return NULL;
+
+    for (entry = cache->entries;  entry;  entry = entry->next) {
+        if (entry->generation == streams->cache_generation && pa_streq(key, entry->key))
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void client_cache_store(struct pa_classify_stream *streams, uint32_t client_idx,
+                               char *key, struct pa_policy_group *group,
+                               uint32_t flags, pa_proplist *properties)
+{
+    struct pa_classify_client_cache *cache;
+    struct pa_classify_cache_entry *entry;
+
+    pa_assert(streams);
+    pa_assert(key);
+
+    if (!streams->cache)
+        streams->cache = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                             pa_idxset_trivial_compare_func,
+                                             NULL,
+                                             client_cache_free);
+
+    if (!(cache = pa_hashmap_get(streams->cache, PA_UINT32_TO_PTR(client_idx)))) {
+        cache = pa_xnew0(struct pa_classify_client_cache, 1);
+        pa_hashmap_put(streams->cache, PA_UINT32_TO_PTR(client_idx), cache);
+    }
+
+    for (entry = cache->entries;  entry;  entry = entry->next) {
+        if (pa_streq(key, entry->key))
+            break;
+    }
+
+    if (entry)
+        pa_xfree(key);
+    else {
+        if (cache->count >= CLIENT_CACHE_MAX) {
+            while ((entry = cache->entries) != NULL) {
+                cache->entries = entry->next;
+                pa_xfree(entry->key);
+                pa_xfree(entry);
+            }
+            cache->count = 0;
+        }
+
+        entry = pa_xnew0(struct pa_classify_cache_entry, 1);
+        entry->key  = key;
+        entry->next = cache->entries;
+        cache->entries = entry;
+        cache->count++;
+    }
+
+    entry->generation = streams->cache_generation;
+    entry->group      = group;
+    entry->flags      = flags;
+    entry->properties = properties;
 }
 
 static void classify_port_entry_free(void *data) {
@@ -1172,6 +2084,9 @@ static void device_def_free(struct pa_classify_device_def *d)
 
     pa_xfree(d->data.module);
         pa_xfree(d->data.module_args);
+
+    if (d->objects)
+        pa_idxset_free(d->objects, NULL);
 }
 
 static void devices_free(struct pa_classify_device *devices)
@@ -1182,6 +2097,8 @@ static void devices_free(struct pa_classify_device *devices)
         for (d = devices->defs;  d->type;  d++)
             device_def_free(d);
 
+        pa_policy_match_set_free(devices->matches);
+        pa_xfree(devices->types);
         pa_xfree(devices);
     }
 }
@@ -1198,6 +2115,7 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
     char *ports_string = NULL; /* Just for log output. */
     pa_strbuf *buf; /* For building ports_string. */
     bool replace = false;
+    int i;
 
     pa_assert(p_devices);
     pa_assert_se((devs = *p_devices));
@@ -1209,14 +2127,13 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
     pa_policy_var_update(u, module);
     pa_policy_var_update(u, module_args);
 
-    for (d = devs->defs;  d->type;  d++) {
-        if (pa_streq(type, d->type)) {
-            replace = true;
-            break;
-        }
+    if ((i = devices_find_type(devs, type)) >= 0) {
+        d = devs->defs + i;
+        replace = true;
     }
 
     if (replace && d) {
+        pa_policy_match_set_remove(devs->matches, d - devs->defs);
         device_def_free(d);
         memset(d, 0, sizeof(*d));
     } else {
@@ -1234,12 +2151,19 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
 
     if (!d->dev_match) {
         pa_log("%s: invalid device definition %s", __FUNCTION__, type);
+        type_index_set(&devs->types, &devs->ntype, pa_policy_atom_lookup(type), -1);
         memset(d, 0, sizeof(*d));
+        devs->generation++;
         return;
     }
 
     d->type = pa_xstrdup(type);
 
+    classify_matches_add(devs->matches, d->dev_match, d - devs->defs);
+
+    d->atom = pa_policy_atom_intern(type);
+    type_index_set(&devs->types, &devs->ntype, d->atom, d - devs->defs);
+
     buf = pa_strbuf_new();
 
     if (ports && !pa_idxset_isempty(ports)) {
@@ -1290,6 +2214,8 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
 
     devs->ndef++;
 
+    devs->generation++;
+
 #if (PULSEAUDIO_VERSION >= 8)
     ports_string = pa_strbuf_to_string_free(buf);
 #else
@@ -1303,18 +2229,94 @@ static void devices_add(struct userdata *u, struct pa_classify_device **p_device
     pa_xfree(ports_string);
 }
 
-static int devices_classify(struct pa_classify_device *devices, const void *object,
+/* atom of a device or card type => definition index + 1 */
+static void type_index_set(uint32_t **types, uint32_t *ntype,
+                           pa_policy_atom atom, int idx)
+{
+    uint32_t n;
+
+    if (atom == PA_POLICY_ATOM_INVALID)
+        return;
+
+    if (atom >= *ntype) {
+        if (idx < 0)
+            return;
+
+        n = *ntype;
+        *ntype = atom + 16;
+        *types = pa_xrenew(uint32_t, *types, *ntype);
+        memset(*types + n, 0, sizeof(uint32_t) * (*ntype - n));
+    }
+
+    (*types)[atom] = idx + 1;
+}
+
+static int type_index_get(uint32_t *types, uint32_t ntype, const char *type)
+{
+    pa_policy_atom atom = pa_policy_atom_lookup(type);
+
+    if (atom >= ntype)
+        return -1;
+
+    return (int)types[atom] - 1;
+}
+
+static int devices_find_type(struct pa_classify_device *devices, const char *type)
+{
+    return type_index_get(devices->types, devices->ntype, type);
+}
+
+static struct pa_classify_memo *devices_memo(struct pa_classify_device *devices,
+                                             struct pa_classify_memo **memo_ptr,
+                                             enum pa_policy_object_type obj_type,
+                                             const void *object)
+{
+    struct pa_classify_memo *memo = *memo_ptr;
+    struct pa_classify_device_def *d;
+    const uint32_t *matched;
+    uint32_t i;
+
+    if (memo && memo->generation == devices->generation)
+        return memo;
+
+    pa_classify_memo_free(memo);
+
+    memo = pa_xnew0(struct pa_classify_memo, 1);
+    memo->generation = devices->generation;
+    memo->ndef       = devices->ndef;
+    memo->matched    = pa_xnew0(bool, memo->ndef + 1);
+    memo->ports      = pa_xnew0(struct pa_classify_port_entry *, memo->ndef + 1);
+
+    matched = pa_policy_match_set_run(devices->matches, object);
+
+    for (d = devices->defs;  d->type;  d++) {
+        i = d - devices->defs;
+
+        memo->matched[i] = classify_match(d->dev_match, object, matched, i);
+
+        if (d->data.ports)
+            memo->ports[i] = pa_classify_get_port_entry(&d->data, obj_type, (void *) object);
+    }
+
+    *memo_ptr = memo;
+
+    return memo;
+}
+
+static int devices_classify(struct pa_classify_device *devices,
+                            struct pa_classify_memo *memo,
                             uint32_t flag_mask, uint32_t flag_value,
                             struct pa_classify_result **result)
 {
     struct pa_classify_device_def *d;
 
+    pa_assert(memo);
     pa_assert(result);
 
     *result = classify_result_malloc(devices->ndef);
 
     for (d = devices->defs;  d->type;  d++) {
-        if (pa_policy_match(d->dev_match, object)) {
+        if (memo->matched[d - devices->defs]) {
             if ((d->data.flags & flag_mask) == flag_value) {
                 pa_assert((*result)->count < devices->ndef);
                 classify_result_append(result, d->type);
@@ -1325,23 +2327,21 @@ static int devices_classify(struct pa_classify_device *devices, const void *obje
     return (*result)->count;
 }
 
-static int devices_is_typeof(struct pa_classify_device_def *defs, const void *object,
+static int devices_is_typeof(struct pa_classify_device *devices,
+                             struct pa_classify_memo *memo,
                              const char *type, struct pa_classify_device_data **data)
 {
-    struct pa_classify_device_def *d;
+    int i;
 
-    for (d = defs;  d->type;  d++) {
-        if (!strcmp(type, d->type)) {
-            if (pa_policy_match(d->dev_match, object)) {
-                if (data != NULL)
-                    *data = &d->data;
+    pa_assert(memo);
 
-                return true;
-            }
-        }
-    }
+    if ((i = devices_find_type(devices, type)) < 0 || !memo->matched[i])
+        return false;
 
-    return false;
+    if (data != NULL)
+        *data = &devices->defs[i].data;
+
+    return true;
 }
 
 static void card_def_free(struct pa_classify_card_def *d)
@@ -1355,6 +2355,9 @@ static void card_def_free(struct pa_classify_card_def *d)
     for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++) {
         pa_xfree(d->data[i].profile);
         pa_policy_match_free(d->data[i].card_match);
+
+        if (d->data[i].objects)
+            pa_idxset_free(d->data[i].objects, NULL);
     }
 }
 
@@ -1366,6 +2369,8 @@ static void cards_free(struct pa_classify_card *cards)
         for (d = cards->defs;  d->type;  d++)
             card_def_free(d);
 
+        pa_policy_match_set_free(cards->matches);
+        pa_xfree(cards->types);
         pa_xfree(cards);
     }
 }
@@ -1388,14 +2393,15 @@ static void cards_add(struct userdata *u, struct pa_classify_card **p_cards,
     /* update variable */
     pa_policy_var_update(u, type);
 
-    for (d = cards->defs;  d->type;  d++) {
-        if (pa_streq(type, d->type)) {
-            replace = true;
-            break;
-        }
+    if ((i = cards_find_type(cards, type)) >= 0) {
+        d = cards->defs + i;
+        replace = true;
     }
 
     if (replace && d) {
+        for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++)
+            pa_policy_match_set_remove(cards->matches,
+                                       (d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i);
         card_def_free(d);
         memset(d, 0, sizeof(*d));
     } else {
@@ -1423,10 +2429,18 @@ static void cards_add(struct userdata *u, struct pa_classify_card **p_cards,
                                                     arg_str);
         if (!data->card_match)
             goto fail;
+
+        classify_matches_add(cards->matches, data->card_match,
+                             (d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i);
     }
 
+    d->atom = pa_policy_atom_intern(type);
+    type_index_set(&cards->types, &cards->ntype, d->atom, d - cards->defs);
+
     cards->ndef++;
 
+    cards->generation++;
+
     pa_log_info("card '%s' %s (%s|%s|%s|0x%04x)", type, replace ? "updated" : "added",
                 pa_match_method_str(method[0]), pa_policy_var(u, arg[0]),
                 d->data[0].profile ? d->data[0].profile : "", d->data[0].flags);
@@ -1439,11 +2453,55 @@ static void cards_add(struct userdata *u, struct pa_classify_card **p_cards,
 
 fail:
     pa_log("%s: invalid card definition %s", __FUNCTION__, type);
+    type_index_set(&cards->types, &cards->ntype, pa_policy_atom_lookup(type), -1);
+    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS; i++)
+        pa_policy_match_set_remove(cards->matches,
+                                   (d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i);
     memset(d, 0, sizeof(*d));
+    cards->generation++;
+}
+
+static int cards_find_type(struct pa_classify_card *cards, const char *type)
+{
+    return type_index_get(cards->types, cards->ntype, type);
+}
+
+static struct pa_classify_memo *cards_memo(struct pa_classify_card *cards,
+                                           struct pa_classify_memo **memo_ptr,
+                                           pa_card *card)
+{
+    struct pa_classify_memo *memo = *memo_ptr;
+    struct pa_classify_card_def *d;
+    const uint32_t *matched;
+    uint32_t id;
+    int i;
+
+    if (memo && memo->generation == cards->generation)
+        return memo;
+
+    pa_classify_memo_free(memo);
+
+    memo = pa_xnew0(struct pa_classify_memo, 1);
+    memo->generation = cards->generation;
+    memo->ndef       = cards->ndef * PA_POLICY_CARD_MAX_DEFS;
+    memo->matched    = pa_xnew0(bool, memo->ndef + PA_POLICY_CARD_MAX_DEFS);
+
+    matched = pa_policy_match_set_run(cards->matches, card);
+
+    for (d = cards->defs;  d->type;  d++) {
+        for (i = 0; i < PA_POLICY_CARD_MAX_DEFS && d->data[i].profile; i++) {
+            id = (d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i;
+            memo->matched[id] = classify_match(d->data[i].card_match, card, matched, id);
+        }
+    }
+
+    *memo_ptr = memo;
+
+    return memo;
 }
 
 static int cards_classify(struct pa_classify_card *cards,
-                          pa_card *card, pa_hashmap *card_profiles,
+                          struct pa_classify_memo *memo, pa_hashmap *card_profiles,
                           uint32_t flag_mask, uint32_t flag_value,
                           bool reclassify, struct pa_classify_result **result)
 {
@@ -1453,6 +2511,7 @@ static int cards_classify(struct pa_classify_card *cards,
     int              i;
     bool             supports_profile;
 
+    pa_assert(memo);
     pa_assert(result);
 
     /* one card definition may have multiple sets of defines */
@@ -1466,7 +2525,7 @@ static int cards_classify(struct pa_classify_card *cards,
 
             data = &d->data[i];
 
-            if (pa_policy_match(data->card_match, card)) {
+            if (memo->matched[(d - cards->defs) * PA_POLICY_CARD_MAX_DEFS + i]) {
                 supports_profile = false;
 
                 if (data->profile == NULL)
@@ -1490,51 +2549,50 @@ static int cards_classify(struct pa_classify_card *cards,
     return (*result)->count;
 }
 
-static int card_is_typeof(struct pa_classify_card_def *defs, pa_card *card,
+static int card_is_typeof(struct pa_classify_card *cards, struct pa_classify_memo *memo,
                           const char *type, struct pa_classify_card_data **data, int *priority)
 {
     struct pa_classify_card_def *d;
+    int idx;
     int i;
 
-    for (d = defs;  d->type;  d++) {
-        if (!strcmp(type, d->type)) {
+    pa_assert(memo);
 
-            for (i = 0; i < PA_POLICY_CARD_MAX_DEFS && d->data[i].profile; i++) {
-                if (pa_policy_match(d->data[i].card_match, card)) {
-                    if (data != NULL)
-                        *data = &d->data[i];
-                    if (priority != NULL)
-                        *priority = i;
+    if ((idx = cards_find_type(cards, type)) < 0)
+        return false;
 
-                    return true;
-                }
-            }
+    d = cards->defs + idx;
+
+    for (i = 0; i < PA_POLICY_CARD_MAX_DEFS && d->data[i].profile; i++) {
+        if (memo->matched[idx * PA_POLICY_CARD_MAX_DEFS + i]) {
+            if (data != NULL)
+                *data = &d->data[i];
+            if (priority != NULL)
+                *priority = i;
+
+            return true;
         }
     }
 
     return false;
 }
 
-static int port_device_is_typeof(struct pa_classify_device_def *defs,
-                                 enum pa_policy_object_type obj_type,
-                                 void *obj,
+static int port_device_is_typeof(struct pa_classify_device *devices,
+                                 struct pa_classify_memo *memo,
                                  const char *type,
                                  struct pa_classify_device_data **data)
 {
-    struct pa_classify_device_def *d;
+    int i;
 
-    for (d = defs;  d->type;  d++) {
-        if (pa_streq(type, d->type)) {
-            if (d->data.ports && pa_classify_get_port_entry(&d->data, obj_type, obj)) {
-                if (data)
-                    *data = &d->data;
+    pa_assert(memo);
 
-                return true;
-            }
-        }
-    }
+    if ((i = devices_find_type(devices, type)) < 0 || !memo->ports[i])
+        return false;
 
-    return false;
+    if (data)
+        *data = &devices->defs[i].data;
+
+    return true;
 }
 
 struct pa_classify_port_entry *pa_classify_get_port_entry(struct pa_classify_device_data *data,
@@ -4,6 +4,7 @@
 #include <sys/types.h>
 
 #include "match.h"
+#include "atom.h"
 #include "userdata.h"
 
 #define PA_POLICY_PID_HASH_BITS  6
@@ -38,6 +39,7 @@ struct pa_source;
 struct pa_sink_input;
 struct pa_sink_input_new_data;
 struct pa_card;
+struct pa_policy_group;
 
 struct pa_classify_pid_hash {
     struct pa_classify_pid_hash *next;
@@ -45,10 +47,14 @@ struct pa_classify_pid_hash {
                                         /* for stream classification */
     pa_policy_match_object      *pid_match;
     char                        *group; /* policy group name */
+    struct pa_policy_group      *grp;   /* the group, once it exists */
 };
 
 struct pa_classify_stream_def {
     struct pa_classify_stream_def *next;
+    struct pa_classify_stream_def *inext; /* next def in the index bucket */
+    struct pa_classify_stream_def *snext; /* next def with the same sname */
+    uint32_t                       seq;   /* position in the configuration */
                                           /* for stream classification */
     pa_policy_match_object        *stream_match;
     uid_t                          uid;   /* user id, if any */
@@ -57,14 +63,41 @@ struct pa_classify_stream_def {
     char                          *sname; /* active routing sink name, if any */
     uid_t                          sact;  /* routing sink active */
     char                          *group; /* policy group name */
+    pa_policy_atom                 gatom; /* atom of the group name */
+    struct pa_policy_group        *grp;   /* the group, once it exists */
     uint32_t                       flags; /* PA_POLICY_LOCAL_ROUTE |
                                              PA_POLICY_LOCAL_MUTE   */
     pa_proplist                   *properties;
 };
 
+/* Stream definitions are indexed by the most selective key they have
+ * (exe, client name, equals: property value or uid, in this order).
+ * Definitions without any of these go to the 'any' bucket. Each bucket
+ * keeps its definitions in configuration order. */
+struct pa_classify_stream_bucket {
+    struct pa_classify_stream_def *first;
+    struct pa_classify_stream_def *last;
+};
+
+struct pa_classify_stream_index {
+    pa_hashmap                       *exe;   /* exe name => bucket */
+    pa_hashmap                       *clnam; /* client name => bucket */
+    pa_hashmap                       *uid;   /* user id => bucket */
+    pa_hashmap                       *props; /* property name => value => bucket */
+    struct pa_classify_stream_bucket  any;
+};
+
 struct pa_classify_stream {
-    struct pa_classify_pid_hash   *pid_hash[PA_POLICY_PID_HASH_MAX];
-    struct pa_classify_stream_def *defs;
+    struct pa_classify_pid_hash    *pid_hash[PA_POLICY_PID_HASH_MAX];
+    struct pa_classify_stream_def  *defs;
+    uint32_t                        ndef;
+    struct pa_classify_stream_index index;
+    pa_policy_match_set            *matches; /* stream_match of defs by seq */
+    pa_idxset                      *props; /* property names used in matching */
+    pa_hashmap                     *cache; /* client index => cached results */
+    uint32_t                        cache_generation;
+    pa_hashmap                     *snames; /* sname => first def routing to it */
+    char                           *sactive; /* currently active sname, if any */
 };
 
 struct pa_classify_port_config_entry {
@@ -92,12 +125,19 @@ struct pa_classify_device_data {
 
 struct pa_classify_device_def {
     char                            *type;  /* device type, e.g. ihf */
+    pa_policy_atom                   atom;  /* atom of the type */
                                             /* for classification */
     pa_policy_match_object          *dev_match;
     struct pa_classify_device_data   data;  /* data associated with device */
+    pa_idxset                       *objects; /* sinks or sources of the type */
 };
 
 struct pa_classify_device {
+    pa_policy_match_set             *matches; /* dev_match of defs by index */
+    uint32_t                        *types;   /* type atom => index + 1 */
+    uint32_t                         ntype;
+    uint32_t                         generation; /* bumped when defs change */
+    uint32_t                         index_generation; /* of the objects */
     int                              ndef;
     struct pa_classify_device_def    defs[1];
 };
@@ -106,18 +146,38 @@ struct pa_classify_card_data {
     char                        *profile; /* name of profile */
     uint32_t                     flags;   /* PA_POLICY_DISABLE_NOTIFY, etc */
     pa_policy_match_object      *card_match;
+    pa_idxset                   *objects; /* cards matching this set first */
 };
 
 struct pa_classify_card_def {
     char                        *type;    /* handled device name, e.g ihf */
+    pa_policy_atom               atom;    /* atom of the type */
     struct pa_classify_card_data data[2]; /* data associated with device 'type' */
 };
 
 struct pa_classify_card {
+    pa_policy_match_set         *matches; /* card_match of defs by index *
+                                           * PA_POLICY_CARD_MAX_DEFS + set */
+    uint32_t                    *types;   /* type atom => index + 1 */
+    uint32_t                     ntype;
+    uint32_t                     generation; /* bumped when defs change */
+    uint32_t                     index_generation; /* of the objects */
     int                          ndef;
     struct pa_classify_card_def  defs[1];
 };
 
+/* Classification of a sink, source or card against all definitions,
+ * kept in the extension of the object. It is recomputed when the
+ * definitions change (generation) or dropped when the object's
+ * properties change. */
+struct pa_classify_memo {
+    uint32_t                        generation;
+    uint32_t                        ndef;
+    bool                           *matched; /* by definition id */
+    struct pa_classify_port_entry **ports;   /* by definition index, */
+                                             /* devices only */
+};
+
 struct pa_classify_module {
     const char                  *module_name;
     const char                  *module_args;
@@ -156,20 +216,30 @@ void  pa_classify_add_stream(struct userdata *, const char *,enum pa_classify_me
                              const char *, const char *, const char *, uid_t, const char *, const char *,
                              uint32_t, const char *, const char *);
 void  pa_classify_update_stream_route(struct userdata *u, const char *sname);
+void  pa_classify_update_sink_activity(struct userdata *u);
+void  pa_classify_bind_group(struct userdata *u, struct pa_policy_group *group);
+/* Bind the stream definitions to their groups once the configuration is
+ * read. Classification then returns the bound group, without lookups. */
+void  pa_classify_bind_groups(struct userdata *u);
 
 void  pa_classify_register_pid(struct userdata *, pid_t, const char *,
                                enum pa_classify_method, const char *, const char *);
 void  pa_classify_unregister_pid(struct userdata *, pid_t, const char *,
                                  enum pa_classify_method, const char *);
-
-const char *pa_classify_sink_input(struct userdata *u, struct pa_sink_input *sinp,
-                                   uint32_t *flags);
-const char *pa_classify_sink_input_by_data(struct userdata *u,
-                                           struct pa_sink_input_new_data *sinp,
-                                           uint32_t *flags);
-const char *pa_classify_source_output(struct userdata *u, struct pa_source_output *sout);
-const char *pa_classify_source_output_by_data(struct userdata *u,
-                                        struct pa_source_output_new_data *data);
+void  pa_classify_forget_client(struct userdata *, uint32_t);
+
+struct pa_policy_group *pa_classify_sink_input(struct userdata *u,
+                                               struct pa_sink_input *sinp,
+                                               uint32_t *flags);
+struct pa_policy_group *pa_classify_sink_input_by_data(struct userdata *u,
+                                                       struct pa_sink_input_new_data *sinp,
+                                                       uint32_t *flags);
+struct pa_policy_group *pa_classify_source_output(struct userdata *u,
+                                                  struct pa_source_output *sout,
+                                                  uint32_t *flags);
+struct pa_policy_group *pa_classify_source_output_by_data(struct userdata *u,
+                                                          struct pa_source_output_new_data *data,
+                                                          uint32_t *flags);
 
 int   pa_classify_sink(struct userdata *, struct pa_sink *,
                        uint32_t, uint32_t, struct pa_classify_result **result);
@@ -194,6 +264,19 @@ int   pa_classify_is_source_typeof(struct userdata *, struct pa_source *,
 int   pa_classify_is_card_typeof(struct userdata *, struct pa_card *,
                                  const char *, struct pa_classify_card_data **, int *priority);
 
+/* Index of sinks, sources and cards by device type. Objects are
+ * registered when they are put and unregistered when unlinked. */
+void  pa_classify_register_sink(struct userdata *, struct pa_sink *);
+void  pa_classify_unregister_sink(struct userdata *, struct pa_sink *);
+struct pa_sink *pa_classify_find_sink(struct userdata *, const char *);
+void  pa_classify_register_source(struct userdata *, struct pa_source *);
+void  pa_classify_unregister_source(struct userdata *, struct pa_source *);
+struct pa_source *pa_classify_find_source(struct userdata *, const char *);
+void  pa_classify_register_card(struct userdata *, struct pa_card *);
+void  pa_classify_unregister_card(struct userdata *, struct pa_card *);
+struct pa_card *pa_classify_find_card(struct userdata *, const char *, int priority,
+                                      struct pa_classify_card_data **);
+
 /* The ports= option in the [device] section may contain multiple sinks or
  * sources of which port should be set. These two functions are used to find
  * out whether the port of the given sink or source should be set. */
@@ -207,6 +290,8 @@ struct pa_classify_port_entry *pa_classify_get_port_entry(struct pa_classify_dev
                                                           enum pa_policy_object_type,
                                                           void *);
 
+void pa_classify_memo_free(struct pa_classify_memo *);
+
 int pa_classify_update_module(struct userdata *u, uint32_t dir, struct pa_classify_device_data *device);
 void pa_classify_update_modules(struct userdata *u, uint32_t dir, const char *type);
 
@@ -10,9 +10,16 @@
 #include <config.h>
 #endif
 #include <pulse/def.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include "userdata.h"
 #include "client-ext.h"
+#include "classify.h"
+#include "client-proc.h"
+
+#define PASSWD_FILE "/etc/passwd"
+#define PASSWD_CHECK_INTERVAL (5 * PA_USEC_PER_SEC)
 
 static void handle_client_events(pa_core *, pa_subscription_event_type_t,
 				 uint32_t, void *);
@@ -21,9 +28,11 @@ static void handle_new_or_modified_client(struct userdata  *,
                                           struct pa_client *);
 static void handle_removed_client(struct userdata *, uint32_t);
 
-static char *client_ext_dump(struct pa_client *, char *, int);
+static char *client_ext_dump(struct userdata *, struct pa_client *, char *, int);
 
-static void client_ext_set_arg0(struct pa_client *client);
+static void client_ext_free(void *);
+static struct pa_client_ext *client_ext_update(struct userdata *, struct pa_client *);
+static uid_t client_ext_resolve_uid(struct userdata *, const char *);
 
 struct pa_client_evsubscr *pa_client_ext_subscription(struct userdata *u)
 {
@@ -39,7 +48,12 @@ struct pa_client_evsubscr *pa_client_ext_subscription(struct userdata *u)
 
     subscr = pa_xnew0(struct pa_client_evsubscr, 1);
     
-    subscr->events = events;
+    subscr->events  = events;
+    subscr->clients = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                          pa_idxset_trivial_compare_func,
+                                          NULL,
+                                          client_ext_free);
+    subscr->proc    = pa_client_proc_new(u);
     
     return subscr;
 }
@@ -48,6 +62,13 @@ void pa_client_ext_subscription_free(struct pa_client_evsubscr *subscr)
 {
     if (subscr != NULL) {
         pa_subscription_free(subscr->events);
+
+        pa_client_proc_free(subscr->proc);
+
+        pa_hashmap_free(subscr->clients);
+
+        if (subscr->users)
+            pa_hashmap_free(subscr->users);
         
         pa_xfree(subscr);
     }
@@ -67,6 +88,22 @@ void pa_client_ext_discover(struct userdata *u)
         handle_new_or_modified_client(u, client);
 }
 
+struct pa_client_ext *pa_client_ext_lookup(struct userdata *u,
+                                           struct pa_client *client)
+{
+    struct pa_client_ext *ext;
+
+    pa_assert(u);
+    pa_assert(u->scl);
+    pa_assert(client);
+
+    /* streams may get classified before the client event is dispatched */
+    if (!(ext = pa_hashmap_get(u->scl->clients, PA_UINT32_TO_PTR(client->index))))
+        ext = client_ext_update(u, client);
+
+    return ext;
+}
+
 const char *pa_client_ext_name(struct pa_client *client)
 {
     const char *name;
@@ -110,54 +147,15 @@ pid_t pa_client_ext_pid(struct pa_client *client)
     return pid;
 }
 
-uid_t pa_client_ext_uid(struct pa_client *client)
+uid_t pa_client_ext_uid(struct userdata *u, struct pa_client *client)
 {
-    const char     *uidstr;
-    bool            valid;
-    struct passwd  *pwd;
-    uid_t           uid;
-    char           *e;
+    struct pa_client_ext *ext;
 
     assert(client);
 
-    valid = false;
-    uidstr = pa_proplist_gets(client->proplist,
-                              PA_PROP_APPLICATION_PROCESS_USER);
+    ext = pa_client_ext_lookup(u, client);
 
-    /* POSIX requires[0] that commands dealing with user id first attempt to
-     * resolve the specified string as a name, and only once that fails,
-     * then try to interpret the string as an ID. Due to this we'll behave
-     * the same way, first check for string then number.
-     *
-     * [0] https://www.gnu.org/software/coreutils/manual/coreutils.html#Disambiguating-names-and-IDs */
-
-    /* first try to interpret user id as string */
-    if (uidstr) {
-        setpwent();
-
-        while ((pwd = getpwent())) {
-            if (!strcmp(uidstr, pwd->pw_name)) {
-                uid = pwd->pw_uid;
-                valid = true;
-                break;
-            }
-        }
-
-        endpwent();
-    }
-
-    /* if no user was found, interpret user id as number */
-    if (!valid && uidstr) {
-        uid = strtoul(uidstr, &e, 10);
-
-        if (*uidstr != '\0' && *e == '\0')
-            valid = true;
-    }
-
-    if (valid)
-        return uid;
-
-    return 0;
+    return ext->uid;
 }
 
 const char *pa_client_ext_exe(struct pa_client *client)
@@ -191,10 +189,7 @@ const char *pa_client_ext_arg0(struct pa_client *client)
     assert(client);
 
     arg0 = pa_proplist_gets(client->proplist, PA_PROP_APPLICATION_PROCESS_ARG0);
-    
-    if (arg0 == NULL)
-        client_ext_set_arg0(client);
-    
+
     return arg0;
 }
 
@@ -239,54 +234,154 @@ static void handle_new_or_modified_client(struct userdata  *u,
     uint32_t idx = client->index;
     char     buf[1024];
 
+    client_ext_update(u, client);
+
     pa_log_debug("new/modified client (idx=%d) %s", idx,
-                 client_ext_dump(client, buf, sizeof(buf)));
+                 client_ext_dump(u, client, buf, sizeof(buf)));
+
+    pa_classify_forget_client(u, idx);
 }
 
 static void handle_removed_client(struct userdata *u, uint32_t idx)
 {
     pa_log_debug("client removed (idx=%d)", idx);
+
+    pa_hashmap_remove_and_free(u->scl->clients, PA_UINT32_TO_PTR(idx));
+    pa_classify_forget_client(u, idx);
 }
 
 
-static void client_ext_set_arg0(struct pa_client *client)
+static void client_ext_free(void *data)
 {
-    char  path[256], arg0[1024];
-    int   fd, len;
-    pid_t pid;
-
-    if (!(pid = pa_client_ext_pid(client))) {
-        /*
-          application.process.id property is set not for all kinds
-          of pulseaudio clients, and not right after a client creation
-        */
-        pa_log_debug("no pid property for client %u, skip it", client->index);
-        return;
+    struct pa_client_ext *ext = data;
+
+    pa_assert(ext);
+
+    pa_xfree(ext->name);
+    pa_xfree(ext->exe);
+    pa_xfree(ext);
+}
+
+
+static struct pa_client_ext *client_ext_update(struct userdata  *u,
+                                               struct pa_client *client)
+{
+    struct pa_client_ext *ext;
+    const char           *name;
+    const char           *exe;
+
+    pa_assert(u);
+    pa_assert(u->scl);
+    pa_assert(client);
+
+    if (!(ext = pa_hashmap_get(u->scl->clients, PA_UINT32_TO_PTR(client->index)))) {
+        ext = pa_xnew0(struct pa_client_ext, 1);
+        pa_hashmap_put(u->scl->clients, PA_UINT32_TO_PTR(client->index), ext);
     }
 
-    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
-    if ((fd = open(path, O_RDONLY)) < 0) {
-        pa_log("can't obtain command line");
-        return;
+    name = pa_client_ext_name(client);
+    exe  = pa_client_ext_exe(client);
+
+    if (!pa_safe_streq(name, ext->name)) {
+        pa_xfree(ext->name);
+        ext->name = pa_xstrdup(name);
     }
 
-    for (;;) {
-        if ((len = read(fd, arg0, sizeof(arg0)-1)) < 0) {
-            if (errno == EINTR)
-                continue;
-            else {
-                arg0[0] = '\0';
-                break;
-            }
+    if (!pa_safe_streq(exe, ext->exe)) {
+        pa_xfree(ext->exe);
+        ext->exe = pa_xstrdup(exe);
+    }
+
+    ext->pid = pa_client_ext_pid(client);
+    ext->uid = client_ext_resolve_uid(u, pa_proplist_gets(client->proplist,
+                                                          PA_PROP_APPLICATION_PROCESS_USER));
+
+    /* cmdline, exe and cgroup are read asynchronously and end up in the
+     * client proplist once available */
+    if (ext->pid && ext->pid != ext->proc_pid) {
+        pa_client_proc_request(u->scl->proc, client->index, ext->pid);
+        ext->proc_pid = ext->pid;
+    }
+
+    return ext;
+}
+
+
+static uid_t client_ext_resolve_uid(struct userdata *u, const char *uidstr)
+{
+    struct pa_client_evsubscr *subscr;
+    struct stat                st;
+    struct passwd             *pwd;
+    uid_t                     *cached;
+    pa_usec_t                  now;
+    bool                       valid;
+    uid_t                      uid;
+    char                      *e;
+
+    pa_assert(u);
+    pa_assert_se((subscr = u->scl));
+
+    if (!uidstr)
+        return 0;
+
+    /* resolved names are valid as long as the user database is unchanged,
+     * which is checked at most once in PASSWD_CHECK_INTERVAL */
+    now = pa_rtclock_now();
+
+    if (!subscr->users || now - subscr->passwd_check >= PASSWD_CHECK_INTERVAL) {
+        if (stat(PASSWD_FILE, &st) < 0)
+            st.st_mtime = 0;
+
+        if (subscr->users && st.st_mtime != subscr->passwd_mtime) {
+            pa_log_debug("%s changed, forget resolved user names", PASSWD_FILE);
+            pa_hashmap_free(subscr->users);
+            subscr->users = NULL;
         }
-        
-        arg0[len] = '\0';
-        break;
+
+        subscr->passwd_mtime = st.st_mtime;
+        subscr->passwd_check = now;
+    }
+
+    if (subscr->users && (cached = pa_hashmap_get(subscr->users, uidstr)))
+        return *cached;
+
+    valid = false;
+
+    /* POSIX requires[0] that commands dealing with user id first attempt to
+     * resolve the specified string as a name, and only once that fails,
+     * then try to interpret the string as an ID. Due to this we'll behave
+     * the same way, first check for string then number.
+     *
+     * [0] https://www.gnu.org/software/coreutils/manual/coreutils.html#Disambiguating-names-and-IDs */
+
+    /* first try to interpret user id as string */
+    if ((pwd = getpwnam(uidstr))) {
+        uid = pwd->pw_uid;
+        valid = true;
+    }
+
+    /* if no user was found, interpret user id as number */
+    if (!valid) {
+        uid = strtoul(uidstr, &e, 10);
+
+        if (*uidstr != '\0' && *e == '\0')
+            valid = true;
     }
 
-    close(fd);
+    if (!valid)
+        uid = 0;
+
+    if (!subscr->users)
+        subscr->users = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                            pa_idxset_string_compare_func,
+                                            pa_xfree,
+                                            pa_xfree);
+
+    cached  = pa_xnew(uid_t, 1);
+    *cached = uid;
+    pa_hashmap_put(subscr->users, pa_xstrdup(uidstr), cached);
 
-    pa_proplist_sets(client->proplist, PA_PROP_APPLICATION_PROCESS_ARG0, arg0);
+    return uid;
 }
 
 
@@ -346,7 +441,8 @@ static void client_ext_set_args(struct pa_client *client)
 #endif
 
 
-static char *client_ext_dump(struct pa_client *client, char *buf, int len)
+static char *client_ext_dump(struct userdata *u, struct pa_client *client,
+                             char *buf, int len)
 {
     const char  *name;
     const char  *id;
@@ -361,7 +457,7 @@ static char *client_ext_dump(struct pa_client *client, char *buf, int len)
         name = pa_client_ext_name(client);
         id   = pa_client_ext_id(client);
         pid  = pa_client_ext_pid(client);
-        uid  = pa_client_ext_uid(client);
+        uid  = pa_client_ext_uid(u, client);
         exe  = pa_client_ext_exe(client);
         args = pa_client_ext_args(client);
         arg0 = pa_client_ext_arg0(client);
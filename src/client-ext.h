@@ -10,18 +10,34 @@
 #include "userdata.h"
 
 struct pa_client;
+struct pa_client_proc;
+
+/* identity of a client as used by the stream classification */
+struct pa_client_ext {
+    pid_t                    pid;
+    uid_t                    uid;
+    char                    *name;
+    char                    *exe;
+    pid_t                    proc_pid;     /* pid whose /proc data was requested */
+};
 
 struct pa_client_evsubscr {
     pa_subscription         *events;
+    pa_hashmap              *clients;      /* client index => pa_client_ext */
+    pa_hashmap              *users;        /* user name => uid */
+    time_t                   passwd_mtime; /* of /etc/passwd when users was filled */
+    pa_usec_t                passwd_check; /* when passwd_mtime was last checked */
+    struct pa_client_proc   *proc;         /* /proc data collector */
 };
 
 struct pa_client_evsubscr *pa_client_ext_subscription(struct userdata *);
 void   pa_client_ext_subscription_free(struct pa_client_evsubscr *);
 void   pa_client_ext_discover(struct userdata *);
+struct pa_client_ext *pa_client_ext_lookup(struct userdata *, struct pa_client *);
 const char *pa_client_ext_name(struct pa_client *);
 const char *pa_client_ext_id(struct pa_client *);
 pid_t  pa_client_ext_pid(struct pa_client *);
-uid_t  pa_client_ext_uid(struct pa_client *);
+uid_t  pa_client_ext_uid(struct userdata *, struct pa_client *);
 const char *pa_client_ext_exe(struct pa_client *);
 const char *pa_client_ext_args(struct pa_client *);
 const char *pa_client_ext_arg0(struct pa_client *);
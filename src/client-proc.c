@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/log.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/hashmap.h>
+
+#include "client-proc.h"
+#include "client-ext.h"
+
+/* Process data is read from /proc in a worker thread so that the main
+ * loop never blocks on procfs. The worker keeps the data of the pids it
+ * has seen, keyed by pid and validated with the process start time, so a
+ * reused pid is read again. Results are handed back to the main loop via
+ * a list protected by the mutex and a wakeup pipe. */
+
+#define PROC_CACHE_MAX  256
+#define PROC_ARGS_MAX   4096
+
+struct pa_client_proc_entry {
+    struct pa_client_proc_entry *next;
+    uint32_t                     client;  /* client index */
+    pid_t                        pid;
+    unsigned long long           start;   /* process start time */
+    char                        *arg0;
+    char                        *args;
+    char                        *exe;
+    char                        *cgroup;
+};
+
+struct pa_client_proc {
+    struct userdata             *userdata;
+    pa_thread                   *thread;
+    pa_mutex                    *mutex;
+    pa_cond                     *cond;
+    bool                         quit;
+    struct pa_client_proc_entry *requests;  /* main loop => worker */
+    struct pa_client_proc_entry *results;   /* worker => main loop */
+    int                          pipe[2];
+    pa_io_event                 *io;
+    pa_hashmap                  *cache;     /* pid => entry, worker only */
+};
+
+static void entry_free(void *);
+static void entry_append(struct pa_client_proc_entry **,
+                         struct pa_client_proc_entry *);
+static void proc_thread(void *);
+static void proc_read(struct pa_client_proc *, struct pa_client_proc_entry *);
+static bool proc_read_start(pid_t, unsigned long long *);
+static int  proc_read_file(pid_t, const char *, char *, size_t);
+static void proc_results_cb(pa_mainloop_api *, pa_io_event *, int,
+                            pa_io_event_flags_t, void *);
+
+
+struct pa_client_proc *pa_client_proc_new(struct userdata *u)
+{
+    struct pa_client_proc *proc;
+
+    pa_assert(u);
+    pa_assert(u->core);
+
+    proc = pa_xnew0(struct pa_client_proc, 1);
+
+    proc->userdata = u;
+    proc->pipe[0]  = proc->pipe[1] = -1;
+
+    if (pipe(proc->pipe) < 0) {
+        pa_log("failed to create pipe: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    pa_make_fd_nonblock(proc->pipe[0]);
+    pa_make_fd_nonblock(proc->pipe[1]);
+    pa_make_fd_cloexec(proc->pipe[0]);
+    pa_make_fd_cloexec(proc->pipe[1]);
+
+    proc->mutex = pa_mutex_new(false, false);
+    proc->cond  = pa_cond_new();
+    proc->cache = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                      pa_idxset_trivial_compare_func,
+                                      NULL,
+                                      entry_free);
+
+    proc->io = u->core->mainloop->io_new(u->core->mainloop, proc->pipe[0],
+                                         PA_IO_EVENT_INPUT, proc_results_cb,
+                                         proc);
+
+    if (!(proc->thread = pa_thread_new("policy-proc", proc_thread, proc))) {
+        pa_log("failed to start process data collector");
+        goto fail;
+    }
+
+    return proc;
+
+fail:
+    pa_client_proc_free(proc);
+    return NULL;
+}
+
+void pa_client_proc_free(struct pa_client_proc *proc)
+{
+    struct pa_client_proc_entry *e;
+
+    if (proc == NULL)
+        return;
+
+    if (proc->thread) {
+        pa_mutex_lock(proc->mutex);
+        proc->quit = true;
+        pa_cond_signal(proc->cond, false);
+        pa_mutex_unlock(proc->mutex);
+
+        pa_thread_free(proc->thread);
+    }
+
+    if (proc->io)
+        proc->userdata->core->mainloop->io_free(proc->io);
+
+    while ((e = proc->requests) != NULL) {
+        proc->requests = e->next;
+        entry_free(e);
+    }
+
+    while ((e = proc->results) != NULL) {
+        proc->results = e->next;
+        entry_free(e);
+    }
+
+    if (proc->cache)
+        pa_hashmap_free(proc->cache);
+    if (proc->cond)
+        pa_cond_free(proc->cond);
+    if (proc->mutex)
+        pa_mutex_free(proc->mutex);
+
+    if (proc->pipe[0] >= 0)
+        close(proc->pipe[0]);
+    if (proc->pipe[1] >= 0)
+        close(proc->pipe[1]);
+
+    pa_xfree(proc);
+}
+
+void pa_client_proc_request(struct pa_client_proc *proc, uint32_t idx, pid_t pid)
+{
+    struct pa_client_proc_entry *e;
+
+    if (proc == NULL || !pid)
+        return;
+
+    e = pa_xnew0(struct pa_client_proc_entry, 1);
+    e->client = idx;
+    e->pid    = pid;
+
+    pa_mutex_lock(proc->mutex);
+    entry_append(&proc->requests, e);
+    pa_cond_signal(proc->cond, false);
+    pa_mutex_unlock(proc->mutex);
+}
+
+
+static void entry_free(void *data)
+{
+    struct pa_client_proc_entry *e = data;
+
+    pa_assert(e);
+
+    pa_xfree(e->arg0);
+    pa_xfree(e->args);
+    pa_xfree(e->exe);
+    pa_xfree(e->cgroup);
+    pa_xfree(e);
+}
+
+static void entry_append(struct pa_client_proc_entry **list,
+                         struct pa_client_proc_entry *e)
+{
+    struct pa_client_proc_entry *prev;
+
+    e->next = NULL;
+
+    for (prev = (struct pa_client_proc_entry *)list;  prev->next;  prev = prev->next)
+        ;
+
+    prev->next = e;
+}
+
+static void proc_thread(void *userdata)
+{
+    struct pa_client_proc       *proc = userdata;
+    struct pa_client_proc_entry *e;
+    char                         c = 'x';
+
+    pa_assert(proc);
+
+    pa_mutex_lock(proc->mutex);
+
+    for (;;) {
+        while (!proc->quit && !proc->requests)
+            pa_cond_wait(proc->cond, proc->mutex);
+
+        if (proc->quit)
+            break;
+
+        e = proc->requests;
+        proc->requests = e->next;
+
+        pa_mutex_unlock(proc->mutex);
+
+        proc_read(proc, e);
+
+        pa_mutex_lock(proc->mutex);
+
+        entry_append(&proc->results, e);
+
+        if (write(proc->pipe[1], &c, 1) < 0 && errno != EAGAIN)
+            pa_log("failed to wake up main loop: %s", pa_cstrerror(errno));
+    }
+
+    pa_mutex_unlock(proc->mutex);
+}
+
+static void proc_read(struct pa_client_proc *proc, struct pa_client_proc_entry *e)
+{
+    struct pa_client_proc_entry *cached;
+    char                         path[256];
+    char                         buf[PROC_ARGS_MAX];
+    char                        *p;
+    int                          len;
+
+    if (!proc_read_start(e->pid, &e->start)) {
+        pa_hashmap_remove_and_free(proc->cache, PA_UINT32_TO_PTR(e->pid));
+        return;
+    }
+
+    if ((cached = pa_hashmap_get(proc->cache, PA_UINT32_TO_PTR(e->pid)))) {
+        if (cached->start == e->start) {
+            e->arg0   = pa_xstrdup(cached->arg0);
+            e->args   = pa_xstrdup(cached->args);
+            e->exe    = pa_xstrdup(cached->exe);
+            e->cgroup = pa_xstrdup(cached->cgroup);
+            return;
+        }
+
+        /* pid has been reused */
+        pa_hashmap_remove_and_free(proc->cache, PA_UINT32_TO_PTR(e->pid));
+    }
+
+    if ((len = proc_read_file(e->pid, "cmdline", buf, sizeof(buf))) > 0) {
+        e->arg0 = pa_xstrdup(buf);
+
+        for (p = buf;  p < buf + len - 1;  p++) {
+            if (*p == '\0')
+                *p = ' ';
+        }
+
+        e->args = pa_xstrdup(buf);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/exe", e->pid);
+
+    if ((len = readlink(path, buf, sizeof(buf) - 1)) > 0) {
+        buf[len] = '\0';
+        e->exe = pa_xstrdup(buf);
+    }
+
+    if (proc_read_file(e->pid, "cgroup", buf, sizeof(buf)) > 0) {
+        if ((p = strchr(buf, '\n')))
+            *p = '\0';
+
+        e->cgroup = pa_xstrdup(buf);
+    }
+
+    if (pa_hashmap_size(proc->cache) >= PROC_CACHE_MAX)
+        pa_hashmap_remove_all(proc->cache);
+
+    cached = pa_xnew0(struct pa_client_proc_entry, 1);
+    cached->pid    = e->pid;
+    cached->start  = e->start;
+    cached->arg0   = pa_xstrdup(e->arg0);
+    cached->args   = pa_xstrdup(e->args);
+    cached->exe    = pa_xstrdup(e->exe);
+    cached->cgroup = pa_xstrdup(e->cgroup);
+
+    pa_hashmap_put(proc->cache, PA_UINT32_TO_PTR(e->pid), cached);
+}
+
+static bool proc_read_start(pid_t pid, unsigned long long *start)
+{
+    char  buf[1024];
+    char *p;
+    int   i;
+
+    if (proc_read_file(pid, "stat", buf, sizeof(buf)) <= 0)
+        return false;
+
+    /* the process name may contain spaces and parentheses */
+    if (!(p = strrchr(buf, ')')))
+        return false;
+
+    /* skip the fields from state (3rd) to starttime (22nd) */
+    for (i = 0;  i < 20;  i++) {
+        if (!(p = strchr(p + 1, ' ')))
+            return false;
+    }
+
+    return sscanf(p, "%llu", start) == 1;
+}
+
+static int proc_read_file(pid_t pid, const char *name, char *buf, size_t size)
+{
+    char path[256];
+    int  fd, len;
+
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+
+    for (;;) {
+        if ((len = read(fd, buf, size - 1)) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            len = -1;
+            buf[0] = '\0';
+            break;
+        }
+
+        buf[len] = '\0';
+        break;
+    }
+
+    close(fd);
+
+    return len;
+}
+
+static void proc_results_cb(pa_mainloop_api *api, pa_io_event *io, int fd,
+                            pa_io_event_flags_t events, void *userdata)
+{
+    struct pa_client_proc       *proc = userdata;
+    struct userdata             *u;
+    struct pa_client_proc_entry *results, *e;
+    struct pa_client            *client;
+    pa_proplist                 *proplist;
+    char                         buf[64];
+
+    pa_assert(proc);
+    pa_assert_se((u = proc->userdata));
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pa_mutex_lock(proc->mutex);
+    results = proc->results;
+    proc->results = NULL;
+    pa_mutex_unlock(proc->mutex);
+
+    while ((e = results) != NULL) {
+        results = e->next;
+
+        if ((client = pa_idxset_get_by_index(u->core->clients, e->client)) &&
+            pa_client_ext_pid(client) == e->pid)
+        {
+            pa_log_debug("process data for client %u (pid %d) exe '%s'",
+                         e->client, e->pid, e->exe ? e->exe : "<unknown>");
+
+            proplist = pa_proplist_new();
+
+            if (e->arg0)
+                pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_ARG0, e->arg0);
+            if (e->args)
+                pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_ARGS, e->args);
+            if (e->exe)
+                pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_EXE, e->exe);
+            if (e->cgroup)
+                pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_CGROUP, e->cgroup);
+
+            /* posts a client change event, which refreshes the extension
+             * and forgets the classifications made without this data */
+            pa_client_update_proplist(client, PA_UPDATE_REPLACE, proplist);
+            pa_proplist_free(proplist);
+        }
+
+        entry_free(e);
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,27 @@
+#ifndef fooclientprocfoo
+#define fooclientprocfoo
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "userdata.h"
+
+struct pa_client_proc;
+
+struct pa_client_proc *pa_client_proc_new(struct userdata *);
+void pa_client_proc_free(struct pa_client_proc *);
+
+/* Queue reading of the process data of 'pid' for the client 'idx'. The
+ * results are added to the client proplist later from the main loop. */
+void pa_client_proc_request(struct pa_client_proc *, uint32_t idx, pid_t pid);
+
+
+#endif
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
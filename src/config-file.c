@@ -251,8 +251,11 @@ int pa_policy_parse_config_files(struct userdata *u, const char *cfgfile, const
         ret = policy_parse_files_in_configdir(u, cfgdir, &sections);
     if (ret)
         ret = section_close_all(u, &sections);
-    if (ret)
+    if (ret) {
+        /* groups may be defined after the streams referring to them */
+        pa_classify_bind_groups(u);
         pa_log_debug("all configs parsed");
+    }
 
     return ret;
 }
@@ -2198,6 +2201,8 @@ static int flags_parse(struct userdata  *u,
             flags |= PA_POLICY_GROUP_FLAG_CORK_STREAM;
         else if (group && !strcmp(flagname, "mute_by_route"))
             flags |= PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE;
+        else if (group && !strcmp(flagname, "mute_in_place"))
+            flags |= PA_POLICY_GROUP_FLAG_MUTE_IN_PLACE;
         else if (group && !strcmp(flagname, "media_notify"))
             flags |= PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY;
         else if (group && !strcmp(flagname, "dynamic_sink"))
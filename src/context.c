@@ -4,6 +4,8 @@
 #include <config.h>
 #endif
 
+#include <pulsecore/core-subscribe.h>
+
 #include "context.h"
 #include "module-ext.h"
 #include "card-ext.h"
@@ -16,6 +18,7 @@
 
 static struct pa_policy_context_variable
             *add_variable(struct pa_policy_context *, const char *);
+static void index_rules(struct pa_policy_context_variable *);
 static void delete_variable(struct pa_policy_context *,
                             struct pa_policy_context_variable *);
 
@@ -31,11 +34,31 @@ static void  delete_action(union pa_policy_context_action **,
                            union pa_policy_context_action *);
 static int perform_action(struct userdata *, union pa_policy_context_action *,
                           char *);
+static size_t changes_add_value(struct pa_policy_context_changes *, const char *);
+static void changes_begin(struct pa_policy_context_changes *);
+static void changes_end(struct pa_policy_context_changes *);
+static void changes_touch(struct pa_policy_context_changes *,
+                          struct pa_policy_object *);
+static void changes_add(struct pa_policy_context_changes *,
+                        union pa_policy_context_action *, size_t);
 
 static int   value_setup(struct userdata *u, union pa_policy_value *,
                          enum pa_policy_value_type, va_list);
 static void  value_cleanup(union pa_policy_value *);
 
+static struct pa_policy_object *action_object(union pa_policy_context_action *,
+                                              int *);
+static void bindings_invalidate(struct pa_policy_context *);
+static void bindings_build(struct pa_policy_binding_registry *,
+                           struct pa_policy_context_rule *);
+static void bindings_free(struct pa_policy_binding_registry *);
+static struct pa_policy_binding_registry *context_bindings(struct pa_policy_context *);
+static struct pa_policy_binding_registry *activity_bindings(struct pa_policy_context *);
+static void bindings_register(struct pa_policy_binding_registry *,
+                              enum pa_policy_object_type, const char *, void *);
+static void bindings_unregister(struct pa_policy_binding_registry *,
+                                enum pa_policy_object_type, const char *,
+                                void *, unsigned long);
 static void register_object(struct pa_policy_object *,
                             enum pa_policy_object_type,
                             const char *, void *, int);
@@ -43,9 +66,9 @@ static void unregister_object(struct pa_policy_object *,
                               enum pa_policy_object_type, const char *,
                               void *, unsigned long, int);
 static const char *get_object_property(struct pa_policy_object *,const char *);
-static void set_object_property(struct pa_policy_object *,
-                                const char *, const char *);
-static void delete_object_property(struct pa_policy_object *, const char *);
+static int set_object_property(struct pa_policy_object *,
+                               const char *, const char *);
+static int delete_object_property(struct pa_policy_object *, const char *);
 static pa_proplist *get_object_proplist(struct pa_policy_object *);
 static int object_assert(struct userdata *, struct pa_policy_object *);
 static const char *object_name(struct pa_policy_object *);
@@ -65,6 +88,8 @@ struct pa_policy_context *pa_policy_context_new(struct userdata *u)
     struct pa_policy_context *ctx;
 
     ctx = pa_xmalloc0(sizeof(*ctx));
+    ctx->varmap = pa_hashmap_new(pa_idxset_string_hash_func,
+                                 pa_idxset_string_compare_func);
 
     return ctx;
 }
@@ -73,112 +98,36 @@ void pa_policy_context_free(struct pa_policy_context *ctx)
 {
     if (ctx != NULL) {
 
+        bindings_free(&ctx->bindings);
+        bindings_free(&ctx->activity_bindings);
+
         while (ctx->variables != NULL)
             delete_variable(ctx, ctx->variables);
 
         while (ctx->activities != NULL)
             delete_activity(ctx, ctx->activities);
 
-        pa_xfree(ctx);
-    }
-}
-
-static void register_rule(struct pa_policy_context_rule *rule,
-                          enum pa_policy_object_type type,
-                          const char *name, void *ptr) {
-    union  pa_policy_context_action    *actn;
-    struct pa_policy_set_property      *setprop;
-    struct pa_policy_del_property      *delprop;
-    struct pa_policy_override          *overr;
-    struct pa_policy_object            *object;
-    int                                 lineno;
+        pa_hashmap_free(ctx->varmap);
 
-    for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
+        pa_xfree(ctx->changes.queue);
+        pa_xfree(ctx->changes.pool);
+        pa_xfree(ctx->changes.touched);
 
-        switch (actn->any.type) {
+        if (ctx->changes.touchset)
+            pa_hashmap_free(ctx->changes.touchset);
 
-        case pa_policy_set_property:
-            setprop = &actn->setprop;
-            lineno  = setprop->lineno;
-            object  = &setprop->object;
-            break;
+        if (ctx->changes.latest)
+            pa_hashmap_free(ctx->changes.latest);
 
-        case pa_policy_delete_property:
-            delprop = &actn->delprop;
-            lineno  = delprop->lineno;
-            object  = &delprop->object;
-            break;
-
-        case pa_policy_override:
-            overr   = &actn->overr;
-            lineno  = overr->lineno;
-            object  = &overr->object;
-            break;
-
-        default:
-            continue;
-        } /* switch */
-
-        register_object(object, type, name, ptr, lineno);
-
-    }  /* for actn */
+        pa_xfree(ctx);
+    }
 }
 
 void pa_policy_context_register(struct userdata *u,
                                 enum pa_policy_object_type what,
                                 const char *name, void *ptr)
 {
-    struct pa_policy_context_variable *var;
-    struct pa_policy_context_rule     *rule;
-
-    for (var = u->context->variables;   var != NULL;   var = var->next) {
-        for (rule = var->rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, what, name, ptr);
-    }  /*  for var */
-}
-
-static void unregister_rule(struct pa_policy_context_rule *rule,
-                            enum pa_policy_object_type type,
-                            const char *name,
-                            void *ptr,
-                            unsigned long index)
-{
-    union  pa_policy_context_action    *actn;
-    struct pa_policy_set_property      *setprop;
-    struct pa_policy_del_property      *delprop;
-    struct pa_policy_override          *overr;
-    struct pa_policy_object            *object;
-    int                                 lineno;
-
-    for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
-
-        switch (actn->any.type) {
-
-        case pa_policy_set_property:
-            setprop = &actn->setprop;
-            lineno  = setprop->lineno;
-            object  = &setprop->object;
-            break;
-
-        case pa_policy_delete_property:
-            delprop = &actn->delprop;
-            lineno  = delprop->lineno;
-            object  = &delprop->object;
-            break;
-
-        case pa_policy_override:
-            overr   = &actn->overr;
-            lineno  = overr->lineno;
-            object  = &overr->object;
-            break;
-
-        default:
-            continue;
-        } /* switch */
-
-        unregister_object(object, type, name, ptr, index, lineno);
-
-    } /* for actn */
+    bindings_register(context_bindings(u->context), what, name, ptr);
 }
 
 void pa_policy_context_unregister(struct userdata *u,
@@ -187,13 +136,7 @@ void pa_policy_context_unregister(struct userdata *u,
                                   void *ptr,
                                   unsigned long index)
 {
-    struct pa_policy_context_variable *var;
-    struct pa_policy_context_rule     *rule;
-
-    for (var = u->context->variables;   var != NULL;   var = var->next) {
-        for (rule = var->rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-    }  /* for var */
+    bindings_unregister(context_bindings(u->context), type, name, ptr, index);
 }
 
 struct pa_policy_context_rule *
@@ -210,6 +153,8 @@ pa_policy_context_add_property_rule(struct userdata *u, const char *varname,
     variable = add_variable(u->context, varname);
     rule     = add_rule(&variable->rules, method, arg);
 
+    variable->indexed = false;
+
     return rule;
 }
 
@@ -245,6 +190,8 @@ pa_policy_context_add_property_action(struct userdata *u,
 
     setprop->property = pa_xstrdup(prop_name);
 
+    bindings_invalidate(u->context);
+
     va_start(value_arg, value_type);
     value_setup(u, &setprop->value, value_type, value_arg);
     va_end(value_arg);
@@ -279,6 +226,8 @@ pa_policy_context_delete_property_action(struct userdata *u,
 
     delprop->property = pa_xstrdup(prop_name);
 
+    bindings_invalidate(u->context);
+
     append_action(&rule->actions, action);
 }
 
@@ -337,6 +286,8 @@ pa_policy_context_override_action(struct userdata               *u,
 
     overr->profile = pa_xstrdup(profile_name);
 
+    bindings_invalidate(u->context);
+
     va_start(value_arg, value_type);
     value_setup(u, &overr->value, value_type, value_arg);
     va_end(value_arg);
@@ -395,61 +346,267 @@ int pa_policy_context_variable_changed(struct userdata *u, const char *name,
 {
     struct pa_policy_context_variable *var;
     struct pa_policy_context_rule     *rule;
+    struct pa_policy_context_rule     *exact;
+    struct pa_policy_context_rule     *other;
     union pa_policy_context_action    *actn;
+    size_t                             offs;
     int                                success;
 
     success = true;
 
-    for (var = u->context->variables;  var != NULL;  var = var->next) {
-        if (!strcmp(name, var->name)) {
-            if (!strcmp(value, var->value))
-                pa_log_debug("no value change -> no action");
-            else {
-                pa_xfree(var->value);
-                var->value = pa_xstrdup(value);
-
-                for (rule = var->rules;  rule != NULL;  rule = rule->next) {
-                    if (pa_policy_match(rule->match, value)) {
-                        for (actn = rule->actions; actn; actn = actn->any.next)
-                        {
-                            if (u->context->variable_change_count == PA_POLICY_CONTEXT_MAX_CHANGES) {
-                                pa_log_warn("Max policy context value changes, dropping '%s':'%s'", name, value);
-                                return false;
-                            } else {
-                                u->context->variable_change[u->context->variable_change_count].action = actn;
-                                u->context->variable_change[u->context->variable_change_count].value = pa_xstrdup(value);
-                                u->context->variable_change_count++;
-                            }
-                        } /* for actn */
-                    } /* if rule */
-                } /* for rule */
-            }
-            
-            break;
+    if ((var = pa_hashmap_get(u->context->varmap, name)) != NULL) {
+        if (!strcmp(value, var->value))
+            pa_log_debug("no value change -> no action");
+        else {
+            pa_xfree(var->value);
+            var->value = pa_xstrdup(value);
+
+            if (!var->indexed)
+                index_rules(var);
+
+            exact = var->byvalue ? pa_hashmap_get(var->byvalue, value) : NULL;
+            other = var->fallback;
+            offs  = changes_add_value(&u->context->changes, value);
+
+            /* merge the two chains to keep the configuration order */
+            while (exact != NULL || other != NULL) {
+                if (exact && (!other || exact->seq < other->seq)) {
+                    rule  = exact;
+                    exact = exact->vnext;
+                }
+                else {
+                    rule  = other;
+                    other = other->vnext;
+
+                    if (!pa_policy_match(rule->match, value))
+                        continue;
+                }
+
+                for (actn = rule->actions; actn; actn = actn->any.next)
+                    changes_add(&u->context->changes, actn, offs);
+            } /* while rule */
         }
-    } /* for var */
+    }
 
     return success;
 }
 
 void pa_policy_context_variable_commit(struct userdata *u)
 {
-    union pa_policy_context_action *action;
-    char *value;
+    struct pa_policy_context_changes *changes;
+    struct pa_policy_context_change  *change;
+    char     *value;
+    uint32_t  i;
 
     pa_assert(u);
     pa_assert(u->context);
 
-    while (u->context->variable_change_count) {
-        u->context->variable_change_count--;
+    changes = &u->context->changes;
+
+    changes_begin(changes);
 
-        action = u->context->variable_change[u->context->variable_change_count].action;
-        value  = u->context->variable_change[u->context->variable_change_count].value;
+    /* in arrival order */
+    for (i = 0;  i < changes->count;  i++) {
+        change = changes->queue + i;
 
-        if (!perform_action(u, action, value))
+        if (change->action == NULL)
+            continue; /* superseded by a later change */
+
+        value = changes->pool + change->value;
+
+        if (!perform_action(u, change->action, value))
             pa_log("Failed to perform action for value %s", value);
-        pa_xfree(value);
     }
+
+    changes->count   = 0;
+    changes->poollen = 0;
+
+    if (changes->latest)
+        pa_hashmap_remove_all(changes->latest);
+
+    changes_end(changes);
+}
+
+static void changes_begin(struct pa_policy_context_changes *changes)
+{
+    changes->deferred++;
+}
+
+/* Notify once every object whose properties were changed in the
+ * transaction. The hooks may start new transactions; objects touched
+ * by those are appended and notified by the same loop. */
+static void changes_end(struct pa_policy_context_changes *changes)
+{
+    struct pa_policy_context_touch *touch;
+
+    pa_assert(changes->deferred > 0);
+
+    if (changes->deferred > 1) {
+        changes->deferred--;
+        return;
+    }
+
+    while (changes->notified < changes->ntouched) {
+        touch = changes->touched + changes->notified++;
+
+        pa_hashmap_remove(changes->touchset, touch->ptr);
+
+        if (touch->object->ptr == touch->ptr)
+            fire_object_property_changed_hook(touch->object);
+    }
+
+    changes->ntouched = 0;
+    changes->notified = 0;
+    changes->deferred = 0;
+}
+
+static void changes_touch(struct pa_policy_context_changes *changes,
+                          struct pa_policy_object          *object)
+{
+    struct pa_policy_context_touch *touch;
+
+    if (!changes->deferred) {
+        fire_object_property_changed_hook(object);
+        return;
+    }
+
+    if (changes->touchset == NULL)
+        changes->touchset = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                           pa_idxset_trivial_compare_func);
+
+    /* the pointers of the devices and streams are unique across types */
+    if (pa_hashmap_get(changes->touchset, object->ptr))
+        return;
+
+    if (changes->ntouched >= changes->tsize) {
+        changes->tsize   = changes->tsize ? changes->tsize * 2 : 8;
+        changes->touched = pa_xrenew(struct pa_policy_context_touch,
+                                     changes->touched, changes->tsize);
+    }
+
+    touch = changes->touched + changes->ntouched++;
+    touch->object = object;
+    touch->ptr    = object->ptr;
+
+    pa_hashmap_put(changes->touchset, touch->ptr, object);
+}
+
+static size_t changes_add_value(struct pa_policy_context_changes *changes,
+                                const char *value)
+{
+    size_t offs = changes->poollen;
+    size_t len  = strlen(value) + 1;
+
+    if (offs + len > changes->poolsize) {
+        while (offs + len > changes->poolsize)
+            changes->poolsize = changes->poolsize ? changes->poolsize * 2 : 256;
+
+        changes->pool = pa_xrealloc(changes->pool, changes->poolsize);
+    }
+
+    memcpy(changes->pool + offs, value, len);
+    changes->poollen += len;
+
+    return offs;
+}
+
+static const char *change_property(union pa_policy_context_action *action)
+{
+    switch (action->any.type) {
+    case pa_policy_set_property:    return action->setprop.property;
+    case pa_policy_delete_property: return action->delprop.property;
+    default:                        return NULL;
+    }
+}
+
+/* Whether 'later' overwrites whatever 'earlier' would do. */
+static bool change_supersedes(union pa_policy_context_action *earlier,
+                              union pa_policy_context_action *later)
+{
+    struct pa_policy_object *eobj, *lobj;
+    const char              *eprop, *lprop;
+    int                      lineno;
+
+    if (earlier == later)
+        return true;
+
+    if ((earlier->any.type != pa_policy_set_property &&
+         earlier->any.type != pa_policy_delete_property) ||
+        (later->any.type != pa_policy_set_property &&
+         later->any.type != pa_policy_delete_property))
+        return false;
+
+    eobj = action_object(earlier, &lineno);
+    lobj = action_object(later, &lineno);
+
+    if (eobj->ptr == NULL || eobj->ptr != lobj->ptr || eobj->type != lobj->type)
+        return false;
+
+    eprop = change_property(earlier);
+    lprop = change_property(later);
+
+    return pa_safe_streq(eprop, lprop);
+}
+
+/* Hash and compare functions of the 'latest' map. Actions superseding
+ * each other are equal keys: the same action, or property actions of
+ * the same bound object and property. */
+static unsigned change_hash(const void *key)
+{
+    union pa_policy_context_action *action = (void *)key;
+    struct pa_policy_object        *object;
+    const char                     *property;
+    int                             lineno;
+
+    if ((property = change_property(action)) != NULL) {
+        object = action_object(action, &lineno);
+
+        if (object->ptr != NULL) {
+            return pa_idxset_trivial_hash_func(object->ptr) * 31 +
+                   (unsigned)object->type * 7 +
+                   pa_idxset_string_hash_func(property);
+        }
+    }
+
+    return pa_idxset_trivial_hash_func(action);
+}
+
+static int change_compare(const void *a, const void *b)
+{
+    return change_supersedes((void *)a, (void *)b) ? 0 : 1;
+}
+
+static void changes_add(struct pa_policy_context_changes *changes,
+                        union pa_policy_context_action *action,
+                        size_t value)
+{
+    struct pa_policy_context_change *change;
+    void *pos;
+
+    if (changes->latest == NULL)
+        changes->latest = pa_hashmap_new(change_hash, change_compare);
+
+    if ((pos = pa_hashmap_remove(changes->latest, action)) != NULL) {
+        change = changes->queue + (PA_PTR_TO_UINT32(pos) - 1);
+
+        pa_assert(change->action);
+
+        pa_log_debug("context change (line %d) superseded by line %d",
+                     change->action->any.lineno, action->any.lineno);
+        change->action = NULL;
+    }
+
+    if (changes->count >= changes->size) {
+        changes->size  = changes->size ? changes->size * 2 : 16;
+        changes->queue = pa_xrenew(struct pa_policy_context_change,
+                                   changes->queue, changes->size);
+    }
+
+    change = changes->queue + changes->count++;
+    change->action = action;
+    change->value  = value;
+
+    pa_hashmap_put(changes->latest, action, PA_UINT32_TO_PTR(changes->count));
 }
 
 static
@@ -477,6 +634,7 @@ struct pa_policy_context_variable *add_variable(struct pa_policy_context *ctx,
     var->value = pa_xstrdup("");
 
     last->next = var;
+    pa_hashmap_put(ctx->varmap, var->name, var);
 
     pa_log_debug("created context variable '%s'", var->name);
 
@@ -527,8 +685,12 @@ static void delete_variable(struct pa_policy_context          *ctx,
             pa_log_debug("delete context variable '%s'", variable->name);
 #endif
 
+            pa_hashmap_remove(ctx->varmap, variable->name);
             pa_xfree(variable->name);
 
+            if (variable->byvalue)
+                pa_hashmap_free(variable->byvalue);
+
             while (variable->rules != NULL)
                 delete_rule(&variable->rules, variable->rules);
 
@@ -566,6 +728,48 @@ add_rule(struct pa_policy_context_rule    **rules,
     return rule;
 }
 
+static void index_rules(struct pa_policy_context_variable *var)
+{
+    struct pa_policy_context_rule  *rule;
+    struct pa_policy_context_rule  *last;
+    struct pa_policy_context_rule **other;
+    const char *value;
+    uint32_t    seq = 0;
+
+    if (var->byvalue)
+        pa_hashmap_remove_all(var->byvalue);
+    else
+        var->byvalue = pa_hashmap_new(pa_idxset_string_hash_func,
+                                      pa_idxset_string_compare_func);
+
+    var->fallback = NULL;
+    other = &var->fallback;
+
+    for (rule = var->rules;  rule != NULL;  rule = rule->next) {
+        rule->seq   = seq++;
+        rule->vnext = NULL;
+
+        if (pa_policy_match_method(rule->match) == pa_method_equals &&
+            (value = pa_policy_match_arg(rule->match)) != NULL)
+        {
+            if ((last = pa_hashmap_get(var->byvalue, value)) == NULL)
+                pa_hashmap_put(var->byvalue, (void *) value, rule);
+            else {
+                while (last->vnext != NULL)
+                    last = last->vnext;
+
+                last->vnext = rule;
+            }
+        }
+        else {
+            *other = rule;
+            other  = &rule->vnext;
+        }
+    }
+
+    var->indexed = true;
+}
+
 static void delete_rule(struct pa_policy_context_rule **rules,
                         struct pa_policy_context_rule  *rule)
 {
@@ -790,7 +994,9 @@ static int perform_action(struct userdata                *u,
                                  objtype, objname, setprop->property,
                                  prop_value);
 
-                    set_object_property(object, setprop->property, prop_value);
+                    if (set_object_property(object, setprop->property,
+                                            prop_value))
+                        changes_touch(&u->context->changes, object);
                 }
 
                 /* Forward shared strings */
@@ -811,10 +1017,12 @@ static int perform_action(struct userdata                *u,
             objname = object_name(object);
             objtype = pa_policy_object_type_str(object->type);
             
-            pa_log_debug("deleting %s '%s' property '%s'",
-                         objtype, objname, delprop->property);
-            
-            delete_object_property(object, delprop->property);
+            if (delete_object_property(object, delprop->property)) {
+                pa_log_debug("deleted %s '%s' property '%s'",
+                             objtype, objname, delprop->property);
+
+                changes_touch(&u->context->changes, object);
+            }
         }
         break;
 
@@ -891,6 +1099,285 @@ static void value_cleanup(union pa_policy_value *value)
     }
 }
 
+static struct pa_policy_object *action_object(union pa_policy_context_action *actn,
+                                              int *lineno)
+{
+    switch (actn->any.type) {
+
+    case pa_policy_set_property:
+        *lineno = actn->setprop.lineno;
+        return &actn->setprop.object;
+
+    case pa_policy_delete_property:
+        *lineno = actn->delprop.lineno;
+        return &actn->delprop.object;
+
+    case pa_policy_override:
+        *lineno = actn->overr.lineno;
+        return &actn->overr.object;
+
+    default:
+        return NULL;
+    }
+}
+
+static void bindings_invalidate(struct pa_policy_context *ctx)
+{
+    ctx->bindings.valid = false;
+    ctx->activity_bindings.valid = false;
+}
+
+static void binding_chain_free(void *data)
+{
+    struct pa_policy_binding *b;
+    struct pa_policy_binding *next;
+
+    for (b = data;  b;  b = next) {
+        next = b->next;
+        pa_xfree(b);
+    }
+}
+
+static void binding_append(struct pa_policy_binding **chain,
+                           struct pa_policy_binding  *b)
+{
+    while (*chain != NULL)
+        chain = &(*chain)->next;
+
+    *chain = b;
+}
+
+static void binding_bound(struct pa_policy_binding_table *tbl,
+                          struct pa_policy_binding       *b)
+{
+    void *key = PA_UINT32_TO_PTR(b->object->index);
+
+    if (!tbl->bound)
+        tbl->bound = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+
+    if ((b->bnext = pa_hashmap_remove(tbl->bound, key)) == b)
+        b->bnext = NULL; /* can't be bound twice */
+
+    pa_hashmap_put(tbl->bound, key, b);
+}
+
+static void bindings_add(struct pa_policy_binding_registry *reg,
+                         struct pa_policy_object *object, int lineno)
+{
+    struct pa_policy_binding_table *tbl;
+    struct pa_policy_binding       *b;
+    struct pa_policy_binding       *first;
+    pa_policy_match_object         *match;
+    enum pa_policy_object_type      type;
+    enum pa_classify_method         method;
+    const char                     *arg;
+    pa_hashmap                    **map = NULL;
+
+    if (!(match = object->match))
+        return;
+
+    /* string matchers have no type, they never get bound */
+    type = match->type;
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    tbl = &reg->types[type];
+
+    b = pa_xnew0(struct pa_policy_binding, 1);
+    b->object = object;
+    b->lineno = lineno;
+
+    /* the registry is rebuilt while objects may be bound */
+    if (object->ptr != NULL)
+        binding_bound(tbl, b);
+
+    method = pa_policy_match_method(match);
+    arg    = pa_policy_match_arg(match);
+
+    if (match->target == pa_object_name && arg != NULL) {
+        if (method == pa_method_equals)
+            map = &tbl->equals;
+        else if (method == pa_method_startswith) {
+            map = &tbl->startswith;
+
+            if (strlen(arg) > tbl->maxprefix)
+                tbl->maxprefix = strlen(arg);
+        }
+    }
+
+    if (map == NULL) {
+        binding_append(&tbl->other, b);
+        return;
+    }
+
+    if (*map == NULL)
+        *map = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                   pa_idxset_string_compare_func,
+                                   NULL, binding_chain_free);
+
+    if ((first = pa_hashmap_get(*map, arg)) == NULL)
+        pa_hashmap_put(*map, (void *) arg, b);
+    else
+        binding_append(&first, b);
+}
+
+static void bindings_build(struct pa_policy_binding_registry *reg,
+                           struct pa_policy_context_rule *rules)
+{
+    struct pa_policy_context_rule  *rule;
+    union pa_policy_context_action *actn;
+    struct pa_policy_object        *object;
+    int                             lineno;
+
+    for (rule = rules;  rule != NULL;  rule = rule->next) {
+        for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
+            if ((object = action_object(actn, &lineno)) != NULL)
+                bindings_add(reg, object, lineno);
+        }
+    }
+}
+
+static void bindings_free(struct pa_policy_binding_registry *reg)
+{
+    struct pa_policy_binding_table *tbl;
+    int i;
+
+    for (i = 0;  i < pa_policy_object_max;  i++) {
+        tbl = &reg->types[i];
+
+        if (tbl->bound)
+            pa_hashmap_free(tbl->bound);
+        if (tbl->equals)
+            pa_hashmap_free(tbl->equals);
+        if (tbl->startswith)
+            pa_hashmap_free(tbl->startswith);
+
+        binding_chain_free(tbl->other);
+    }
+
+    memset(reg, 0, sizeof(*reg));
+}
+
+static void bind_chain(struct pa_policy_binding_table *tbl,
+                       struct pa_policy_binding *b,
+                       enum pa_policy_object_type type,
+                       const char *name, void *ptr)
+{
+    for (;  b != NULL;  b = b->next) {
+        /* only the unbound ones are of interest */
+        if (b->object->ptr == NULL) {
+            register_object(b->object, type, name, ptr, b->lineno);
+
+            if (b->object->ptr == ptr)
+                binding_bound(tbl, b);
+        }
+    }
+}
+
+static void bindings_register(struct pa_policy_binding_registry *reg,
+                              enum pa_policy_object_type type,
+                              const char *name, void *ptr)
+{
+    struct pa_policy_binding_table *tbl;
+    const char *oname;
+    char       *prefix;
+    size_t      len;
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    tbl   = &reg->types[type];
+    oname = pa_policy_object_name(type, ptr);
+
+    if (oname != NULL && tbl->equals)
+        bind_chain(tbl, pa_hashmap_get(tbl->equals, oname), type, name, ptr);
+
+    if (oname != NULL && tbl->startswith) {
+        len = strlen(oname);
+        if (len > tbl->maxprefix)
+            len = tbl->maxprefix;
+
+        prefix = pa_xstrndup(oname, len);
+
+        for (;;) {
+            prefix[len] = '\0';
+            bind_chain(tbl, pa_hashmap_get(tbl->startswith, prefix), type, name, ptr);
+
+            if (len-- == 0)
+                break;
+        }
+
+        pa_xfree(prefix);
+    }
+
+    bind_chain(tbl, tbl->other, type, name, ptr);
+}
+
+/* Unbind the actions bound to the object. Modules are gone by the time
+ * they are unregistered, so they are identified by their index only. */
+static void bindings_unregister(struct pa_policy_binding_registry *reg,
+                                enum pa_policy_object_type type,
+                                const char *name, void *ptr,
+                                unsigned long index)
+{
+    struct pa_policy_binding_table *tbl;
+    struct pa_policy_binding       *b;
+    struct pa_policy_binding       *next;
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    tbl = &reg->types[type];
+
+    if (!tbl->bound || index == PA_IDXSET_INVALID)
+        return;
+
+    b = pa_hashmap_remove(tbl->bound, PA_UINT32_TO_PTR(index));
+
+    for (;  b != NULL;  b = next) {
+        next = b->bnext;
+        b->bnext = NULL;
+
+        unregister_object(b->object, type, name, ptr, index, b->lineno);
+    }
+}
+
+static struct pa_policy_binding_registry *context_bindings(struct pa_policy_context *ctx)
+{
+    struct pa_policy_context_variable *var;
+
+    if (!ctx->bindings.valid) {
+        bindings_free(&ctx->bindings);
+
+        for (var = ctx->variables;   var != NULL;   var = var->next)
+            bindings_build(&ctx->bindings, var->rules);
+
+        ctx->bindings.valid = true;
+    }
+
+    return &ctx->bindings;
+}
+
+static struct pa_policy_binding_registry *activity_bindings(struct pa_policy_context *ctx)
+{
+    struct pa_policy_activity_variable *var;
+
+    if (!ctx->activity_bindings.valid) {
+        bindings_free(&ctx->activity_bindings);
+
+        for (var = ctx->activities;   var != NULL;   var = var->next) {
+            bindings_build(&ctx->activity_bindings, var->active_rules);
+            bindings_build(&ctx->activity_bindings, var->inactive_rules);
+        }
+
+        ctx->activity_bindings.valid = true;
+    }
+
+    return &ctx->activity_bindings;
+}
+
 static void register_object(struct pa_policy_object *object,
                             enum pa_policy_object_type type,
                             const char *name, void *ptr, int lineno)
@@ -923,7 +1410,7 @@ static void unregister_object(struct pa_policy_object *object,
                               unsigned long index,
                               int lineno)
 {
-    if (ptr == object->ptr && index == object->index) {
+    if ((ptr == NULL || ptr == object->ptr) && index == object->index) {
         pa_log_debug("unregistering context-rule for %s '%s' "
                      "(line %d in config file)",
                      pa_policy_object_type_str(type), name, lineno);
@@ -955,30 +1442,38 @@ static const char *get_object_property(struct pa_policy_object *object,
     return value;
 }
 
-static void set_object_property(struct pa_policy_object *object,
-                                const char *property, const char *value)
+/* Return true if the property list of the object was changed. */
+static int set_object_property(struct pa_policy_object *object,
+                               const char *property, const char *value)
 {
     pa_proplist *proplist;
+    const char  *old_value;
 
     if (object->ptr != NULL) {
         if ((proplist = get_object_proplist(object)) != NULL) {
-            pa_proplist_sets(proplist, property, value);
-            fire_object_property_changed_hook(object);
+            old_value = pa_proplist_gets(proplist, property);
+
+            if (old_value == NULL || strcmp(old_value, value)) {
+                pa_proplist_sets(proplist, property, value);
+                return true;
+            }
         }
     }
+
+    return false;
 }
 
-static void delete_object_property(struct pa_policy_object *object,
-                                   const char *property)
+static int delete_object_property(struct pa_policy_object *object,
+                                  const char *property)
 {
     pa_proplist *proplist;
 
     if (object->ptr != NULL) {
-        if ((proplist = get_object_proplist(object)) != NULL) {
-            pa_proplist_unset(proplist, property);
-            fire_object_property_changed_hook(object);
-        }
+        if ((proplist = get_object_proplist(object)) != NULL)
+            return pa_proplist_unset(proplist, property) >= 0;
     }
+
+    return false;
 }
 
 static pa_proplist *get_object_proplist(struct pa_policy_object *object)
@@ -1104,6 +1599,7 @@ static void fire_object_property_changed_hook(struct pa_policy_object *object)
     struct pa_sink_input    *sinp;
     struct pa_source_output *sout;
     struct pa_module        *module;
+    uint32_t                 facility;
 
    switch (object->type) {
 
@@ -1111,30 +1607,35 @@ static void fire_object_property_changed_hook(struct pa_policy_object *object)
         sink = object->ptr;
         core = sink->core;
         hook = PA_CORE_HOOK_SINK_PROPLIST_CHANGED;
+        facility = PA_SUBSCRIPTION_EVENT_SINK;
         break;
         
     case pa_policy_object_source:
         src  = object->ptr;
         core = src->core;
         hook = PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED;
+        facility = PA_SUBSCRIPTION_EVENT_SOURCE;
         break;
         
     case pa_policy_object_sink_input:
         sinp = object->ptr;
         core = sinp->core;
         hook = PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED;
+        facility = PA_SUBSCRIPTION_EVENT_SINK_INPUT;
         break;
         
     case pa_policy_object_source_output:
         sout = object->ptr;
         core = sout->core;
         hook = PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED;
+        facility = PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT;
         break;
 
     case pa_policy_object_module:
         module = object->ptr;
         core = module->core;
         hook = PA_CORE_HOOK_MODULE_PROPLIST_CHANGED;
+        facility = PA_SUBSCRIPTION_EVENT_MODULE;
         break;
         
     default:
@@ -1142,6 +1643,8 @@ static void fire_object_property_changed_hook(struct pa_policy_object *object)
     }
 
    pa_hook_fire(&core->hooks[hook], object->ptr);
+   pa_subscription_post(core, facility | PA_SUBSCRIPTION_EVENT_CHANGE,
+                        object->index);
 }
 
 static unsigned long object_index(enum pa_policy_object_type type, void *ptr)
@@ -1260,11 +1763,15 @@ static int perform_activity_action(pa_sink *sink, struct pa_policy_activity_vari
 
             var->sink_opened = is_opened;
 
+            changes_begin(&var->userdata->context->changes);
+
             for (actn = rule->actions; actn; actn = actn->any.next)
             {
                 if (!perform_action(var->userdata, actn, NULL))
                     pa_log("Failed to perform activity action.");
             }
+
+            changes_end(&var->userdata->context->changes);
         }
     }
 
@@ -1347,15 +1854,7 @@ void pa_policy_activity_register(struct userdata *u,
                                  enum pa_policy_object_type type,
                                  const char *name, void *ptr)
 {
-    struct pa_policy_activity_variable *var;
-    struct pa_policy_context_rule      *rule;
-
-    for (var = u->context->activities;   var != NULL;   var = var->next) {
-        for (rule = var->active_rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, type, name, ptr);
-        for (rule = var->inactive_rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, type, name, ptr);
-    }  /*  for var */
+    bindings_register(activity_bindings(u->context), type, name, ptr);
 }
 
 void pa_policy_activity_unregister(struct userdata *u,
@@ -1364,15 +1863,7 @@ void pa_policy_activity_unregister(struct userdata *u,
                                    void *ptr,
                                    unsigned long index)
 {
-    struct pa_policy_activity_variable *var;
-    struct pa_policy_context_rule      *rule;
-
-    for (var = u->context->activities;   var != NULL;   var = var->next) {
-        for (rule = var->active_rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-        for (rule = var->inactive_rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-    }  /* for var */
+    bindings_unregister(activity_bindings(u->context), type, name, ptr, index);
 }
 
 /*
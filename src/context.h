@@ -4,8 +4,6 @@
 #include "classify.h"
 #include "match.h"
 
-#define PA_POLICY_CONTEXT_MAX_CHANGES (16)
-
 enum pa_policy_action_type {
     pa_policy_action_unknown = 0,
     pa_policy_action_min = pa_policy_action_unknown,
@@ -99,15 +97,25 @@ union pa_policy_context_action {
 
 struct pa_policy_context_rule {
     struct pa_policy_context_rule      *next;
+    struct pa_policy_context_rule      *vnext; /* next rule in the value table */
+    uint32_t                            seq;   /* position within the variable */
     pa_policy_match_object             *match;
     union pa_policy_context_action     *actions;
 };
 
+/* The rules of a variable are also kept in a value table: 'equals' rules
+ * are chained by their value, the rest (startswith, matches, true) are in
+ * the fallback chain. Both chains are in configuration order. The table
+ * is built on the first change of the variable, as actions added later
+ * may still change the match of their rule. */
 struct pa_policy_context_variable {
     struct pa_policy_context_variable  *next;
     char                               *name;
     char                               *value;
     struct pa_policy_context_rule      *rules;
+    pa_hashmap                         *byvalue;  /* value => first rule */
+    struct pa_policy_context_rule      *fallback;
+    bool                                indexed;  /* value table is valid */
 };
 
 struct pa_policy_activity_rule {
@@ -130,14 +138,73 @@ struct pa_policy_activity_variable {
     int                                 sink_opened; /* -1 not set, 0 closed, 1 opened */
 };
 
+/* An action object that gets bound to an object of its type. */
+struct pa_policy_binding {
+    struct pa_policy_binding           *next;
+    struct pa_policy_binding           *bnext; /* next bound to the same object */
+    struct pa_policy_object            *object;
+    int                                 lineno;
+};
+
+/* Action objects of one type. Name matchers with 'equals' and 'startswith'
+ * are indexed by their argument, the rest are tried one by one. */
+struct pa_policy_binding_table {
+    pa_hashmap                         *equals;     /* name => bindings */
+    pa_hashmap                         *startswith; /* prefix => bindings */
+    size_t                              maxprefix;  /* longest prefix */
+    struct pa_policy_binding           *other;
+    pa_hashmap                         *bound;      /* object index => bindings */
+};
+
+/* Action objects by type, rebuilt when actions are added. */
+struct pa_policy_binding_registry {
+    struct pa_policy_binding_table      types[pa_policy_object_max];
+    bool                                valid;
+};
+
+/* An action waiting for the commit and the variable value that triggered
+ * it. The values are kept by offset in the string pool of the queue. */
+struct pa_policy_context_change {
+    union pa_policy_context_action     *action; /* NULL if superseded */
+    size_t                              value;
+};
+
+/* An object whose properties were changed in a transaction, and the
+ * device or stream it was bound to at that time. */
+struct pa_policy_context_touch {
+    struct pa_policy_object            *object;
+    void                               *ptr;
+};
+
+/* Changes of one transaction in arrival order. The storage is kept from
+ * one transaction to the next. Objects whose properties were changed are
+ * collected in 'touched' and notified once at the end of the outermost
+ * transaction; 'notified' counts the ones already done. */
+struct pa_policy_context_changes {
+    struct pa_policy_context_change    *queue;
+    uint32_t                            count;
+    uint32_t                            size;
+    char                               *pool;
+    size_t                              poollen;
+    size_t                              poolsize;
+    pa_hashmap                         *latest;   /* action => position+1 */
+                                                  /* of its last change */
+    struct pa_policy_context_touch     *touched;
+    pa_hashmap                         *touchset; /* ptr of the touched */
+                                                  /* objects not notified yet */
+    uint32_t                            ntouched;
+    uint32_t                            notified;
+    uint32_t                            tsize;
+    int                                 deferred; /* nesting of transactions */
+};
+
 struct pa_policy_context {
     struct pa_policy_context_variable  *variables;
+    pa_hashmap                         *varmap;   /* name => variable */
+    struct pa_policy_binding_registry   bindings;          /* of variables */
+    struct pa_policy_binding_registry   activity_bindings; /* of activities */
     struct pa_policy_activity_variable *activities;
-    struct variable_change {
-        union pa_policy_context_action *action;
-        char                            *value;
-    } variable_change[PA_POLICY_CONTEXT_MAX_CHANGES];
-    int                                 variable_change_count;
+    struct pa_policy_context_changes    changes;
     union pa_policy_context_action     *overrides;
 };
 
@@ -68,6 +68,7 @@ struct routing_decision {      /* temporary storage for routing decision informa
     char *target;
     char *mode;
     char *hwid;
+    struct pa_card_ext_profile_change profiles[PA_POLICY_CARD_MAX_DEFS];
 };
 
 struct pa_policy_dbusif {
@@ -629,6 +630,9 @@ static void handle_action_message(struct userdata *u, DBusMessage *msg)
 
     dbus_message_iter_recurse(&msgit, &arrit);
 
+    /* stream states are applied once, when all the actions are parsed */
+    pa_policy_groupset_begin(u);
+
     do {
         if (dbus_message_iter_get_arg_type(&arrit) != DBUS_TYPE_DICT_ENTRY) {
             success = false;
@@ -670,6 +674,9 @@ static void handle_action_message(struct userdata *u, DBusMessage *msg)
 
     } while (dbus_message_iter_next(&arrit));
 
+    if (pa_policy_groupset_commit(u) < 0)
+        pa_log("failed to apply the policy state of some streams");
+
     pa_policy_context_variable_commit(u);
 
  send_signal:
@@ -752,6 +759,7 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
     struct argrt args;
     pa_proplist *p = NULL;
     struct routing_decision decisions[MAX_ROUTING_DECISIONS];
+    struct pa_policy_route_plan plan;
     int num_decisions = 0;
     int num_decisions_done = 0;
     int i = 0;
@@ -760,6 +768,8 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
     bool route_changed = false;
     bool sink_route_changed = false;
 
+    memset(&plan, 0, sizeof(plan));
+
     /* Parse message. It's safe to bail out here, because we're not moving any streams yet. */
     do {
         i = num_decisions;
@@ -799,6 +809,7 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
                 !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SINK_HWID  )), decisions[i].hwid)) {
 
                 sink_route_changed = route_changed = true;
+                plan.changed[pa_policy_route_to_sink] = true;
                 pa_sink_ext_pending_start(u);
                 pa_log_debug("Sink route has changed");
 
@@ -811,6 +822,7 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
                 !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SOURCE_HWID  )), decisions[i].hwid)) {
 
                 route_changed = true;
+                plan.changed[pa_policy_route_to_source] = true;
                 pa_log_debug("Source route has changed");
             }
         }
@@ -822,9 +834,29 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
         return true;
     }
 
-    /* Detach groups. */
-    num_moving = pa_policy_group_start_move_all(u);
-    pa_log_debug("Policy groups moving: %d", num_moving);
+    /* Plan the change: only streams that are not on the target device
+     * already, or whose card is about to change its profile, need to be
+     * detached. Profiles, ports and modules of all decisions are still set
+     * in one go, because sink and source decisions may share a card. */
+    plan.cards = pa_idxset_new(NULL, NULL);
+
+    for (i = 0; i < num_decisions; i++) {
+        if (decisions[i].class == pa_policy_route_to_sink)
+            plan.target[pa_policy_route_to_sink] = pa_classify_find_sink(u, decisions[i].target);
+        else
+            plan.target[pa_policy_route_to_source] = pa_classify_find_source(u, decisions[i].target);
+
+        pa_card_ext_collect_profile_changes(u, decisions[i].target, plan.cards,
+                                            decisions[i].profiles);
+    }
+
+    /* Detach the streams that move. */
+    num_moving = pa_policy_group_start_move_planned(u, &plan);
+    pa_idxset_free(plan.cards, NULL);
+    plan.cards = NULL;
+
+    pa_log_debug("Policy groups moving: %d (streams detached %u, kept %u)",
+                 num_moving, plan.detached, plan.kept);
 
     if (u->dbusif->route_sources_first) {
         /* Following works only if MAX_ROUTING_DECISIONS is 2, so make sure this is
@@ -854,7 +886,7 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
         pa_module_update_proplist(u->module, PA_UPDATE_REPLACE, p);
         pa_proplist_free(p);
 
-        if (pa_card_ext_set_profile(u, decisions[i].target) < 0 ||
+        if (pa_card_ext_set_profile(u, decisions[i].profiles) < 0 ||
               (decisions[i].class == pa_policy_route_to_sink &&
                  pa_sink_ext_set_ports(u, decisions[i].target) < 0) ||
               (decisions[i].class == pa_policy_route_to_source &&
@@ -894,6 +926,9 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
         }
     }
 
+    pa_log_info("audio route: %u streams moved, %u detached, %u left in place",
+                u->groups->nmoved, plan.detached, plan.kept);
+
     /* Test that no moving groups exist */
     if (num_decisions != num_decisions_done) {
         pa_log_error("Got %d routing decisions. %d decisions were incomplete.",
@@ -937,8 +972,6 @@ static int volume_limit_parser(struct userdata *u, DBusMessageIter *actit)
 
     } while (dbus_message_iter_next(actit));
 
-    pa_sink_ext_set_volumes(u);
-
     return success;
 }
 
@@ -248,6 +248,11 @@ const char *object_name(enum pa_policy_object_type obj_type, const void *obj)
     return NULL;
 }
 
+const char *pa_policy_object_name(enum pa_policy_object_type obj_type, const void *obj)
+{
+    return object_name(obj_type, obj);
+}
+
 const char *object_proplist_get(pa_policy_match_object *obj,
                                 const void *target)
 {
@@ -463,3 +468,639 @@ int pa_classify_method_true(const char *string,
 
     return true;
 }
+
+
+/*
+ * Match sets
+ *
+ * The regular expressions of a rule family are compiled into a single
+ * NFA per match target (name or property). Every expression is turned
+ * into a sequence of positions, each accepting a set of bytes and
+ * optionally repeated ('*'). The states of all expressions are simulated
+ * together as a bitmap, so the checked string is scanned only once no
+ * matter how many expressions there are. As all expressions must match
+ * the whole string, only the states reached at the end of the string
+ * matter.
+ *
+ * Only a subset of the basic regular expression syntax is compiled:
+ * literals, '.', bracket expressions without classes, '*' and the
+ * anchors. Expressions with sub-expressions, intervals, back references
+ * or GNU extensions are evaluated with regexec() as before, as are all
+ * expressions when the string is not plain ASCII ('.' and bracket
+ * expressions match characters, not bytes, in multibyte locales).
+ *
+ * The 'equals' and 'startswith' matchers of a target are put into a
+ * prefix trie, so they are all resolved by walking the string once.
+ */
+
+#define MATCH_SET_BIT(map, n)  ((map)[(n) / 32] |= (1U << ((n) % 32)))
+#define MATCH_SET_HAS(map, n)  ((map)[(n) / 32] &  (1U << ((n) % 32)))
+
+struct match_set_pos {
+    uint32_t                    bytes[256 / 32];
+    bool                        star;
+};
+
+struct match_set_entry {
+    struct match_set_entry     *next;
+    struct match_set_entry     *tnext;  /* next entry of the same trie node */
+                                        /* or of the fallback list */
+    pa_policy_match_object     *obj;
+    uint32_t                    id;
+    int                         accept; /* accept state, -1 if not compiled */
+    bool                        trie;   /* resolved through the trie */
+};
+
+struct match_set_trie {
+    struct match_set_trie      *child;   /* first child */
+    struct match_set_trie      *sibling;
+    unsigned char               c;
+    struct match_set_entry     *equals;  /* strings ending here */
+    struct match_set_entry     *prefix;  /* prefixes ending here */
+};
+
+struct match_set_group {
+    struct match_set_group     *next;
+    pa_policy_match_object     *key;     /* defines the checked string */
+    struct match_set_entry     *entries;
+    uint32_t                    nstate;
+    uint32_t                    nword;   /* words in a state bitmap */
+    uint32_t                   *start;   /* initial states */
+    uint32_t                   *bytes;   /* byte => states accepting it */
+    uint32_t                   *follow;  /* state => states after a byte */
+    uint32_t                   *accepts; /* accept states */
+    struct match_set_entry    **accepting; /* state => entry accepted there */
+    uint32_t                   *cur;
+    uint32_t                   *nxt;
+    struct match_set_trie      *trie;
+    struct match_set_entry     *fallback; /* entries evaluated one by one */
+};
+
+struct pa_policy_match_set {
+    struct match_set_group     *groups;
+    uint32_t                    nid;     /* largest id + 1 */
+    bool                        compiled;
+    uint32_t                   *matched;
+    uint32_t                    nmatched;
+};
+
+static bool match_set_same_target(pa_policy_match_object *a,
+                                  pa_policy_match_object *b)
+{
+    return a->type == b->type && a->target == b->target &&
+           pa_safe_streq(a->target_def, b->target_def);
+}
+
+static bool match_set_parse_bracket(const char **re, struct match_set_pos *pos)
+{
+    const char   *p = *re;
+    bool          negate = false;
+    bool          first = true;
+    unsigned char lo, hi;
+    int           c, i;
+
+    if (*p == '^') {
+        negate = true;
+        p++;
+    }
+
+    for (;;) {
+        if (*p == '\0')
+            return false;
+
+        if (*p == ']' && !first)
+            break;
+
+        if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.'))
+            return false;
+
+        lo = (unsigned char)*p++;
+        hi = lo;
+
+        if (*p == '-' && p[1] != ']' && p[1] != '\0') {
+            hi = (unsigned char)p[1];
+            p += 2;
+
+            /* ranges follow the collation order outside ASCII */
+            if (lo > 127 || hi > 127 || lo > hi)
+                return false;
+        }
+
+        for (c = lo;  c <= hi;  c++)
+            MATCH_SET_BIT(pos->bytes, c);
+
+        first = false;
+    }
+
+    if (negate) {
+        for (i = 0;  i < 256 / 32;  i++)
+            pos->bytes[i] = ~pos->bytes[i];
+    }
+
+    pos->bytes[0] &= ~1U; /* never match NUL */
+
+    *re = p + 1;
+
+    return true;
+}
+
+/* Returns the number of positions of the expression or -1 if it can't be
+ * compiled. 'pos' must have room for strlen(re) positions. */
+static int match_set_parse(const char *re, struct match_set_pos *pos)
+{
+    const char *p = re;
+    int         n = 0;
+    int         i;
+
+    if (*p == '^')
+        p++;
+
+    while (*p) {
+        if (*p == '$' && p[1] == '\0')
+            break;
+
+        if (*p == '*' && n > 0 && p > re && !(p == re + 1 && *re == '^')) {
+            pos[n - 1].star = true;
+            p++;
+            continue;
+        }
+
+        memset(pos + n, 0, sizeof(*pos));
+
+        switch (*p) {
+
+        case '.':
+            for (i = 0;  i < 256 / 32;  i++)
+                pos[n].bytes[i] = ~0U;
+            pos[n].bytes[0] &= ~1U;
+            p++;
+            break;
+
+        case '[':
+            p++;
+            if (!match_set_parse_bracket(&p, pos + n))
+                return -1;
+            break;
+
+        case '\\':
+            if (!p[1] || !strchr(".[]*^$\\", p[1]))
+                return -1;
+            MATCH_SET_BIT(pos[n].bytes, (unsigned char)p[1]);
+            p += 2;
+            break;
+
+        default:
+            MATCH_SET_BIT(pos[n].bytes, (unsigned char)*p);
+            p++;
+            break;
+        }
+
+        n++;
+    }
+
+    return n;
+}
+
+static void match_set_trie_free(struct match_set_trie *t)
+{
+    struct match_set_trie *child;
+
+    if (!t)
+        return;
+
+    while ((child = t->child)) {
+        t->child = child->sibling;
+        match_set_trie_free(child);
+    }
+
+    pa_xfree(t);
+}
+
+static void match_set_trie_add(struct match_set_trie *t, struct match_set_entry *e)
+{
+    const unsigned char   *p;
+    struct match_set_trie *child;
+
+    for (p = (const unsigned char *)e->obj->arg_def;  *p;  p++) {
+        for (child = t->child;  child && child->c != *p;  child = child->sibling)
+            ;
+
+        if (!child) {
+            child = pa_xnew0(struct match_set_trie, 1);
+            child->c = *p;
+            child->sibling = t->child;
+            t->child = child;
+        }
+
+        t = child;
+    }
+
+    if (e->obj->method == pa_method_equals) {
+        e->tnext = t->equals;
+        t->equals = e;
+    }
+    else {
+        e->tnext = t->prefix;
+        t->prefix = e;
+    }
+
+    e->trie = true;
+}
+
+static void match_set_trie_mark(struct match_set_entry *e, uint32_t *matched)
+{
+    for (;  e;  e = e->tnext)
+        MATCH_SET_BIT(matched, e->id);
+}
+
+static void match_set_trie_run(struct match_set_trie *t, const char *string,
+                               uint32_t *matched)
+{
+    const unsigned char *p;
+
+    for (p = (const unsigned char *)string;  ;  p++) {
+        match_set_trie_mark(t->prefix, matched);
+
+        if (!*p) {
+            match_set_trie_mark(t->equals, matched);
+            break;
+        }
+
+        for (t = t->child;  t && t->c != *p;  t = t->sibling)
+            ;
+
+        if (!t)
+            break;
+    }
+}
+
+static void match_set_group_clear(struct match_set_group *g)
+{
+    struct match_set_entry *e;
+
+    match_set_trie_free(g->trie);
+    g->trie = NULL;
+
+    pa_xfree(g->start);
+    pa_xfree(g->bytes);
+    pa_xfree(g->follow);
+    pa_xfree(g->accepts);
+    pa_xfree(g->accepting);
+    pa_xfree(g->cur);
+    pa_xfree(g->nxt);
+
+    g->start  = g->bytes = g->follow = g->accepts = g->cur = g->nxt = NULL;
+    g->accepting = NULL;
+    g->fallback  = NULL;
+    g->nstate = g->nword = 0;
+
+    for (e = g->entries;  e;  e = e->next) {
+        e->accept = -1;
+        e->trie   = false;
+    }
+}
+
+/* Adds to 'map' state 'state' and the states following it through
+ * repeated positions, which may be skipped. */
+static void match_set_closure(const bool *star, const bool *accept,
+                              uint32_t state, uint32_t *map)
+{
+    for (;;) {
+        MATCH_SET_BIT(map, state);
+
+        if (accept[state] || !star[state])
+            break;
+
+        state++;
+    }
+}
+
+static void match_set_group_compile(struct match_set_group *g)
+{
+    struct match_set_entry *e;
+    struct match_set_pos  **parsed;
+    int                    *npos;
+    bool                   *star, *accept;
+    uint32_t                nentry, nstate, state, s;
+    int                     i, j, c;
+
+    match_set_group_clear(g);
+
+    for (nentry = 0, e = g->entries;  e;  e = e->next)
+        nentry++;
+
+    parsed = pa_xnew0(struct match_set_pos *, nentry);
+    npos   = pa_xnew0(int, nentry);
+    nstate = 0;
+
+    for (i = 0, e = g->entries;  e;  e = e->next, i++) {
+        npos[i] = -1;
+
+        if ((e->obj->method == pa_method_equals || e->obj->method == pa_method_startswith) &&
+            e->obj->arg_def)
+        {
+            if (!g->trie)
+                g->trie = pa_xnew0(struct match_set_trie, 1);
+
+            match_set_trie_add(g->trie, e);
+            continue;
+        }
+
+        if (e->obj->method != pa_method_matches || !e->obj->arg_def) {
+            e->tnext = g->fallback;
+            g->fallback = e;
+            continue;
+        }
+
+        parsed[i] = pa_xnew0(struct match_set_pos, strlen(e->obj->arg_def) + 1);
+
+        if ((npos[i] = match_set_parse(e->obj->arg_def, parsed[i])) < 0) {
+            pa_log_debug("regex '%s' is evaluated separately", e->obj->arg_def);
+            e->tnext = g->fallback;
+            g->fallback = e;
+            continue;
+        }
+
+        nstate += npos[i] + 1;
+    }
+
+    if (nstate > 0) {
+        g->nstate = nstate;
+        g->nword  = (nstate + 31) / 32;
+        g->start  = pa_xnew0(uint32_t, g->nword);
+        g->bytes  = pa_xnew0(uint32_t, 256 * g->nword);
+        g->follow = pa_xnew0(uint32_t, nstate * g->nword);
+        g->accepts   = pa_xnew0(uint32_t, g->nword);
+        g->accepting = pa_xnew0(struct match_set_entry *, nstate);
+        g->cur    = pa_xnew0(uint32_t, g->nword);
+        g->nxt    = pa_xnew0(uint32_t, g->nword);
+
+        star   = pa_xnew0(bool, nstate);
+        accept = pa_xnew0(bool, nstate);
+
+        for (state = 0, i = 0, e = g->entries;  e;  e = e->next, i++) {
+            if (npos[i] < 0)
+                continue;
+
+            for (j = 0;  j < npos[i];  j++) {
+                star[state + j] = parsed[i][j].star;
+
+                for (c = 1;  c < 256;  c++) {
+                    if (MATCH_SET_HAS(parsed[i][j].bytes, c))
+                        MATCH_SET_BIT(g->bytes + c * g->nword, state + j);
+                }
+            }
+
+            e->accept = state + npos[i];
+            accept[e->accept] = true;
+            MATCH_SET_BIT(g->accepts, e->accept);
+            g->accepting[e->accept] = e;
+
+            match_set_closure(star, accept, state, g->start);
+
+            state += npos[i] + 1;
+        }
+
+        for (s = 0;  s < nstate;  s++) {
+            if (accept[s])
+                continue;
+
+            /* a repeated position loops back, others advance */
+            match_set_closure(star, accept, star[s] ? s : s + 1,
+                              g->follow + s * g->nword);
+        }
+
+        pa_xfree(star);
+        pa_xfree(accept);
+    }
+
+    for (i = 0;  i < (int)nentry;  i++)
+        pa_xfree(parsed[i]);
+
+    pa_xfree(parsed);
+    pa_xfree(npos);
+}
+
+static void match_set_compile(pa_policy_match_set *set)
+{
+    struct match_set_group *g;
+
+    for (g = set->groups;  g;  g = g->next)
+        match_set_group_compile(g);
+
+    set->nmatched = (set->nid + 31) / 32;
+    pa_xfree(set->matched);
+    set->matched  = pa_xnew0(uint32_t, set->nmatched ? set->nmatched : 1);
+    set->compiled = true;
+}
+
+static void match_set_group_run(struct match_set_group *g, const char *string,
+                                uint32_t *matched)
+{
+    struct match_set_entry *e;
+    const unsigned char    *p;
+    uint32_t               *tmp;
+    uint32_t                active, any;
+    uint32_t                w, b;
+    bool                    ascii = true;
+
+    for (p = (const unsigned char *)string;  *p;  p++) {
+        if (*p > 127) {
+            ascii = false;
+            break;
+        }
+    }
+
+    if (ascii && g->nstate > 0) {
+        memcpy(g->cur, g->start, g->nword * sizeof(uint32_t));
+
+        for (p = (const unsigned char *)string;  *p;  p++) {
+            memset(g->nxt, 0, g->nword * sizeof(uint32_t));
+            any = 0;
+
+            for (w = 0;  w < g->nword;  w++) {
+                active = g->cur[w] & g->bytes[*p * g->nword + w];
+
+                for (b = 0;  active;  b++, active >>= 1) {
+                    if (active & 1) {
+                        uint32_t *follow = g->follow + (w * 32 + b) * g->nword;
+                        uint32_t  i;
+
+                        for (i = 0;  i < g->nword;  i++) {
+                            g->nxt[i] |= follow[i];
+                            any |= follow[i];
+                        }
+                    }
+                }
+            }
+
+            tmp = g->cur;  g->cur = g->nxt;  g->nxt = tmp;
+
+            if (!any)
+                break;
+        }
+    }
+
+    if (g->trie)
+        match_set_trie_run(g->trie, string, matched);
+
+    /* Only the entries whose accept state was reached match. Strings
+     * the automaton can't scan check the compiled entries one by one. */
+    for (w = 0;  w < g->nword;  w++) {
+        active = g->accepts[w];
+
+        if (ascii)
+            active &= g->cur[w];
+
+        for (b = 0;  active;  b++, active >>= 1) {
+            if (!(active & 1))
+                continue;
+
+            e = g->accepting[w * 32 + b];
+
+            if (ascii || e->obj->func(string, &e->obj->arg))
+                MATCH_SET_BIT(matched, e->id);
+        }
+    }
+
+    for (e = g->fallback;  e;  e = e->tnext) {
+        if (e->obj->func(string, &e->obj->arg))
+            MATCH_SET_BIT(matched, e->id);
+    }
+}
+
+pa_policy_match_set *pa_policy_match_set_new(void)
+{
+    return pa_xnew0(pa_policy_match_set, 1);
+}
+
+void pa_policy_match_set_free(pa_policy_match_set *set)
+{
+    struct match_set_group *g;
+    struct match_set_entry *e;
+
+    if (!set)
+        return;
+
+    while ((g = set->groups)) {
+        set->groups = g->next;
+
+        match_set_group_clear(g);
+
+        while ((e = g->entries)) {
+            g->entries = e->next;
+            pa_xfree(e);
+        }
+
+        pa_xfree(g);
+    }
+
+    pa_xfree(set->matched);
+    pa_xfree(set);
+}
+
+void pa_policy_match_set_add(pa_policy_match_set *set,
+                             pa_policy_match_object *obj, uint32_t id)
+{
+    struct match_set_group *g, *prev;
+    struct match_set_entry *e, *last;
+
+    pa_assert(set);
+    pa_assert(obj);
+
+    for (prev = (struct match_set_group *)&set->groups;  (g = prev->next);  prev = g) {
+        if (match_set_same_target(g->key, obj))
+            break;
+    }
+
+    if (!g) {
+        g = pa_xnew0(struct match_set_group, 1);
+        g->key = obj;
+        prev->next = g;
+    }
+
+    e = pa_xnew0(struct match_set_entry, 1);
+    e->obj    = obj;
+    e->id     = id;
+    e->accept = -1;
+
+    for (last = (struct match_set_entry *)&g->entries;  last->next;  last = last->next)
+        ;
+
+    last->next = e;
+
+    if (id >= set->nid)
+        set->nid = id + 1;
+
+    set->compiled = false;
+}
+
+void pa_policy_match_set_remove(pa_policy_match_set *set, uint32_t id)
+{
+    struct match_set_group *g, *gprev;
+    struct match_set_entry *e, *prev;
+
+    pa_assert(set);
+
+    for (gprev = (struct match_set_group *)&set->groups;  (g = gprev->next); ) {
+        for (prev = (struct match_set_entry *)&g->entries;  (e = prev->next); ) {
+            if (e->id == id) {
+                prev->next = e->next;
+                pa_xfree(e);
+                set->compiled = false;
+            }
+            else
+                prev = e;
+        }
+
+        if (!g->entries) {
+            gprev->next = g->next;
+            match_set_group_clear(g);
+            pa_xfree(g);
+        }
+        else {
+            /* the key object may be gone with the removed entry */
+            g->key = g->entries->obj;
+            gprev = g;
+        }
+    }
+}
+
+const uint32_t *pa_policy_match_set_run(pa_policy_match_set *set, const void *target)
+{
+    struct match_set_group *g;
+    const char             *to_check;
+
+    pa_assert(set);
+
+    if (!set->compiled)
+        match_set_compile(set);
+
+    memset(set->matched, 0, set->nmatched * sizeof(uint32_t));
+
+    if (!target)
+        return set->matched;
+
+    for (g = set->groups;  g;  g = g->next) {
+        switch (g->key->target) {
+            case pa_object_string:  to_check = target; break;
+            case pa_object_name:    to_check = object_name(g->key->type, target); break;
+            case pa_object_property:to_check = object_proplist_get(g->key, target); break;
+            default:
+                pa_assert_not_reached();
+                to_check = NULL;
+        }
+
+        if (to_check)
+            match_set_group_run(g, to_check, set->matched);
+    }
+
+    return set->matched;
+}
+
+bool pa_policy_match_set_has(const uint32_t *matched, uint32_t id)
+{
+    pa_assert(matched);
+
+    return MATCH_SET_HAS(matched, id) ? true : false;
+}
@@ -2,6 +2,7 @@
 #define foopolicymatchfoo
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <regex.h>
 
 enum pa_policy_object_type {
@@ -87,5 +88,21 @@ int   pa_classify_method_matches(const char *, union pa_classify_arg *);
 int   pa_classify_method_true(const char *, union pa_classify_arg *);
 
 const char *pa_policy_object_type_str(enum pa_policy_object_type obj_type);
+/* The name a name matcher of the given type checks for the object. */
+const char *pa_policy_object_name(enum pa_policy_object_type obj_type, const void *obj);
+
+/* A match set evaluates all match objects of a rule family at once and
+ * tells which of them matched. Ids are chosen by the caller and should be
+ * small, as the result is a bitmap indexed by them. The result returned
+ * by pa_policy_match_set_run() is valid until the set is run again. */
+typedef struct pa_policy_match_set pa_policy_match_set;
+
+pa_policy_match_set *pa_policy_match_set_new(void);
+void pa_policy_match_set_free(pa_policy_match_set *set);
+void pa_policy_match_set_add(pa_policy_match_set *set,
+                             pa_policy_match_object *obj, uint32_t id);
+void pa_policy_match_set_remove(pa_policy_match_set *set, uint32_t id);
+const uint32_t *pa_policy_match_set_run(pa_policy_match_set *set, const void *target);
+bool pa_policy_match_set_has(const uint32_t *matched, uint32_t id);
 
 #endif
@@ -31,6 +31,7 @@
 #include "log.h"
 #include "userdata.h"
 #include "index-hash.h"
+#include "atom.h"
 #include "config-file.h"
 #include "policy-group.h"
 #include "classify.h"
@@ -127,10 +128,16 @@ int pa__init(pa_module *m) {
     m->userdata = u;
     u->core     = m->core;
     u->module   = m;
+
+    pa_policy_atom_table_ref();
+
     u->nullsink = pa_sink_ext_init_null_sink(nsnam);
     u->nullsource= pa_source_ext_init_null_source(nsource);
     u->hsnk     = pa_index_hash_init(8);
     u->hsi      = pa_index_hash_init(10);
+    u->hso      = pa_index_hash_init(8);
+    u->hsrc     = pa_index_hash_init(8);
+    u->hcrd     = pa_index_hash_init(6);
     u->scl      = pa_client_ext_subscription(u);
     u->ssnk     = pa_sink_ext_subscription(u);
     u->ssrc     = pa_source_ext_subscription(u);
@@ -215,9 +222,14 @@ void pa__done(pa_module *m) {
     pa_policy_context_free(u->context);
     pa_index_hash_free(u->hsnk);
     pa_index_hash_free(u->hsi);
+    pa_source_output_ext_release(u);
+    pa_index_hash_free(u->hso);
+    pa_index_hash_free(u->hsrc);
+    pa_index_hash_free(u->hcrd);
     pa_sink_ext_null_sink_free(u->nullsink);
     pa_source_ext_null_source_free(u->nullsource);
     pa_shared_data_unref(u->shared);
+    pa_policy_atom_table_unref();
 
     
     pa_xfree(u);
@@ -0,0 +1,122 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulse/proplist.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/idxset.h>
+
+#include "pending-stream.h"
+
+#define PENDING_SERIAL_KEY      "x-policy.pending.serial"
+#define PENDING_MAX             32
+
+
+void pa_policy_pending_init(struct pa_policy_pending *pending)
+{
+    pa_assert(pending);
+
+    pending->streams = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                           pa_idxset_trivial_compare_func,
+                                           NULL, pa_xfree);
+    pending->serial  = 0;
+    pending->expired = 0;
+}
+
+void pa_policy_pending_done(struct pa_policy_pending *pending)
+{
+    pa_assert(pending);
+
+    if (pending->streams) {
+        pa_hashmap_free(pending->streams);
+        pending->streams = NULL;
+    }
+}
+
+void pa_policy_pending_clear(pa_proplist *proplist)
+{
+    pa_assert(proplist);
+
+    pa_proplist_unset(proplist, PENDING_SERIAL_KEY);
+}
+
+struct pa_policy_pending_stream *pa_policy_pending_add(struct pa_policy_pending *pending,
+                                                       pa_proplist *proplist,
+                                                       void *data,
+                                                       pa_client *client,
+                                                       pa_module *module)
+{
+    struct pa_policy_pending_stream *ps;
+
+    pa_assert(pending);
+    pa_assert(proplist);
+
+    /* Streams that failed after the NEW hook never get put. Forget the
+     * oldest entries so that those don't pile up. */
+    while (pa_hashmap_size(pending->streams) >= PENDING_MAX)
+        pa_hashmap_remove_and_free(pending->streams,
+                                   PA_UINT32_TO_PTR(pending->expired++));
+
+    ps = pa_xnew0(struct pa_policy_pending_stream, 1);
+    ps->serial = pending->serial++;
+    ps->data   = data;
+    ps->client = client;
+    ps->module = module;
+
+    pa_hashmap_put(pending->streams, PA_UINT32_TO_PTR(ps->serial), ps);
+    pa_proplist_set(proplist, PENDING_SERIAL_KEY,
+                    (void *)&ps->serial, sizeof(ps->serial));
+
+    return ps;
+}
+
+struct pa_policy_pending_stream *pa_policy_pending_get(struct pa_policy_pending *pending,
+                                                       pa_proplist *proplist,
+                                                       void *data,
+                                                       pa_client *client,
+                                                       pa_module *module)
+{
+    struct pa_policy_pending_stream *ps;
+    const void                      *serial;
+    size_t                           len = 0;
+
+    pa_assert(pending);
+    pa_assert(proplist);
+
+    if (pa_proplist_get(proplist, PENDING_SERIAL_KEY, &serial, &len) < 0 ||
+        len != sizeof(uint32_t))
+        return NULL;
+
+    ps = pa_hashmap_get(pending->streams,
+                        PA_UINT32_TO_PTR(*(const uint32_t *)serial));
+
+    if (ps == NULL || (data && ps->data != data) ||
+        ps->client != client || ps->module != module)
+        return NULL;
+
+    return ps;
+}
+
+void pa_policy_pending_remove(struct pa_policy_pending *pending,
+                              struct pa_policy_pending_stream *ps,
+                              pa_proplist *proplist)
+{
+    pa_assert(pending);
+    pa_assert(proplist);
+
+    pa_proplist_unset(proplist, PENDING_SERIAL_KEY);
+
+    if (ps)
+        pa_hashmap_remove_and_free(pending->streams,
+                                   PA_UINT32_TO_PTR(ps->serial));
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,56 @@
+#ifndef foopendingstreamfoo
+#define foopendingstreamfoo
+
+#include <stdint.h>
+
+#include <pulse/proplist.h>
+#include <pulsecore/client.h>
+#include <pulsecore/module.h>
+#include <pulsecore/hashmap.h>
+
+struct pa_policy_group;
+
+/* Classification of a stream done in the NEW hook, carried over to the
+ * FIXATE and PUT hooks. The new data and the stream made of it are tied
+ * to the entry by a serial number in their proplist. As the proplist is
+ * writable by the client, the entry also records whose it is. */
+struct pa_policy_pending_stream {
+    uint32_t                serial;
+    struct pa_policy_group *group;
+    uint32_t                flags;
+    void                   *data;    /* new data of the stream */
+    pa_client              *client;
+    pa_module              *module;
+};
+
+struct pa_policy_pending {
+    pa_hashmap             *streams;  /* serial => pending stream */
+    uint32_t                serial;   /* serial of the latest new stream */
+    uint32_t                expired;  /* serials below this are gone */
+};
+
+void pa_policy_pending_init(struct pa_policy_pending *);
+void pa_policy_pending_done(struct pa_policy_pending *);
+
+/* Forget any serial in the proplist of a new stream. Called in the NEW
+ * hook before anything else, so only a serial set there refers to us. */
+void pa_policy_pending_clear(pa_proplist *);
+struct pa_policy_pending_stream *pa_policy_pending_add(struct pa_policy_pending *,
+                                                       pa_proplist *, void *data,
+                                                       pa_client *, pa_module *);
+/* The new data is checked only if given, ie. before PUT. */
+struct pa_policy_pending_stream *pa_policy_pending_get(struct pa_policy_pending *,
+                                                       pa_proplist *, void *data,
+                                                       pa_client *, pa_module *);
+void pa_policy_pending_remove(struct pa_policy_pending *,
+                              struct pa_policy_pending_stream *, pa_proplist *);
+
+#endif /* foopendingstreamfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -16,6 +16,7 @@
 #include "variable.h"
 #include "context.h"
 #include "match.h"
+#include "index-hash.h"
 
 #define MUTE   1
 #define UNMUTE 0
@@ -33,35 +34,57 @@ struct target {
 };
 
 
-struct cursor {
-    int idx;
-    struct pa_policy_group *grp;
-};
-
-
 static struct pa_sink   *defsink;
 static struct pa_source *defsource;
 static uint32_t          defsinkidx = PA_IDXSET_INVALID;
-static uint32_t          defsrcidx  = PA_IDXSET_INVALID;
 static pa_volume_t       dbtbl[300];
 
-static int move_group(struct pa_policy_group *, struct target *);
+/* the flags of the groupset's capability lists, by pa_policy_group_cap */
+static const uint32_t    cap_flags[PA_POLICY_GROUP_CAP_MAX] = {
+    PA_POLICY_GROUP_FLAG_ROUTE_AUDIO,
+    PA_POLICY_GROUP_FLAG_DYNAMIC_SINK
+};
+
+static int move_group(struct pa_policy_groupset *, struct pa_policy_group *,
+                      struct target *);
 static int volset_group(struct userdata *, struct pa_policy_group *,
                         pa_volume_t);
 static int mute_group_by_route(struct userdata *u, struct pa_policy_group *, int);
+static int mute_group_in_place(struct userdata *u, struct pa_policy_group *, int);
 static int mute_group_locally(struct userdata *, struct pa_policy_group *,int);
 static int cork_group(struct userdata *u, struct pa_policy_group *, int);
-
-static struct pa_policy_group *group_scan(struct pa_policy_groupset *,
-                                          struct cursor *);
+static int groupset_apply(struct userdata *);
+static void want_cork(struct userdata *, struct pa_sink_input *, bool);
+static void want_limit(struct userdata *, struct pa_sink_input *, pa_volume_t);
+static void want_route(struct userdata *, struct pa_sink_input *, bool);
+
+static void sinp_member_add(struct pa_policy_group *,
+                            struct pa_sink_input_member *);
+static void sinp_member_remove(struct pa_sink_input_member *);
+static void sout_member_add(struct pa_policy_group *,
+                            struct pa_source_output_member *);
+static void sout_member_remove(struct pa_source_output_member *);
+
+static void grouplist_add(struct pa_policy_grouplist *, struct pa_policy_group *);
+static void grouplist_remove(struct pa_policy_grouplist *, struct pa_policy_group *);
+static void grouplist_free(void *);
+static struct pa_policy_grouplist *groups_at(pa_hashmap *, uint32_t);
+static void groups_move(pa_hashmap *, struct pa_policy_group *,
+                        uint32_t, uint32_t);
+static void group_set_sink(struct pa_policy_groupset *, struct pa_policy_group *,
+                           struct pa_sink *);
+static void group_set_source(struct pa_policy_groupset *, struct pa_policy_group *,
+                             struct pa_source *);
 static struct pa_policy_group *find_group_by_name(struct pa_policy_groupset *,
-                                                  const char *, uint32_t *);
+                                                  const char *);
+static void groupset_update_sink_activity(struct userdata *, struct pa_sink *,
+                                         struct pa_sink *);
+static bool group_update_sink_activity(struct userdata *, struct pa_policy_group *,
+                                       struct pa_sink *);
 
 static struct pa_sink   *find_sink_by_type(struct userdata *, const char *);
 static struct pa_source *find_source_by_type(struct userdata *, const char *);
 
-static uint32_t hash_value(const char *);
-
 
 struct pa_policy_groupset *pa_policy_groupset_new(struct userdata *u)
 {
@@ -83,14 +106,33 @@ struct pa_policy_groupset *pa_policy_groupset_new(struct userdata *u)
     }
     
     gset = pa_xnew0(struct pa_policy_groupset, 1);
+    gset->bysink = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                       pa_idxset_trivial_compare_func,
+                                       NULL, grouplist_free);
+    gset->bysource = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                         pa_idxset_trivial_compare_func,
+                                         NULL, grouplist_free);
 
     return gset;
 }
 
 void pa_policy_groupset_free(struct pa_policy_groupset *gset)
 {
+    int i;
+
     pa_assert(gset);
 
+    pa_hashmap_free(gset->bysink);
+    pa_hashmap_free(gset->bysource);
+
+    for (i = 0;  i < PA_POLICY_GROUP_CAP_MAX;  i++)
+        pa_xfree(gset->bycap[i].groups);
+
+    pa_xfree(gset->sinkbound.groups);
+    pa_xfree(gset->sourcebound.groups);
+    pa_xfree(gset->all.groups);
+    pa_xfree(gset->queue);
+    pa_xfree(gset->byatom);
     pa_xfree(gset);
 }
 
@@ -98,8 +140,9 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
 {
     struct pa_policy_groupset *gset;
     struct pa_policy_group    *group;
+    struct pa_policy_grouplist *list;
     const char                *defsinkname;
-    int                        i;
+    uint32_t                   i;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
@@ -112,17 +155,14 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
     if (defsink != NULL && defsinkidx == idx) {
         pa_log_debug("Unset default sink (idx=%d)", idx);
 
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i]; group; group = group->next) {
-                if (group->sinkidx == defsinkidx) {
-                    pa_log_debug("  unset default sink for group '%s'",
-                                 group->name);
-                    group->sink = NULL;
-                    group->sinkidx = PA_IDXSET_INVALID;
-                }
-            }
+        while ((list = groups_at(gset->bysink, defsinkidx)) != NULL) {
+            group = list->groups[0];
+
+            pa_log_debug("  unset default sink for group '%s'", group->name);
+
+            group_set_sink(gset, group, NULL);
         }
-        
+
         defsink = NULL;
         defsinkidx = PA_IDXSET_INVALID;
     }
@@ -141,16 +181,13 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
             pa_log_debug("Set default sink to '%s' (idx=%d)",
                          defsinkname, defsinkidx);
 
-            for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-                for (group = gset->hash_tbl[i]; group; group = group->next) {
-                    if (group->sinkname == NULL && group->sink == NULL) {
-                        pa_log_debug("  set sink '%s' as default for "
-                                     "group '%s'", defsinkname, group->name);
-                        group->sink = defsink;
-                        group->sinkidx = defsinkidx;
+            PA_POLICY_GROUPLIST_FOREACH(group, &gset->all, i) {
+                if (group->sinkname == NULL && group->sink == NULL) {
+                    pa_log_debug("  set sink '%s' as default for "
+                                 "group '%s'", defsinkname, group->name);
+                    group_set_sink(gset, group, defsink);
 
-                        /* TODO: we should move the streams to defsink */
-                    }
+                    /* TODO: we should move the streams to defsink */
                 }
             }
         }
@@ -166,7 +203,7 @@ static void policy_groupset_register_sink(struct userdata *u,
     struct pa_policy_group    *group;
     const char                *sinkname;
     uint32_t                   sinkidx;
-    int                        i;
+    uint32_t                   i;
 
     pa_assert(u);
     pa_assert(sink);
@@ -179,18 +216,15 @@ static void policy_groupset_register_sink(struct userdata *u,
         if (initial_register)
             pa_log_debug("Register sink '%s' (idx=%d)", sinkname, sinkidx);
 
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i];    group;    group = group->next) {
-                if (pa_policy_group_sink(group, sink) &&
-                    group->sink != sink) {
-                    pa_log_debug("  set sink '%s' as default for group '%s'",
-                                 sinkname, group->name);
+        PA_POLICY_GROUPLIST_FOREACH(group, &gset->sinkbound, i) {
+            if (pa_policy_group_sink(group, sink) &&
+                group->sink != sink) {
+                pa_log_debug("  set sink '%s' as default for group '%s'",
+                             sinkname, group->name);
 
-                    group->sink    = sink;
-                    group->sinkidx = sinkidx;
+                group_set_sink(gset, group, sink);
 
-                    /* TODO: we should move the streams to the sink */
-                }
+                /* TODO: we should move the streams to the sink */
             }
         }
     }
@@ -205,25 +239,21 @@ void pa_policy_groupset_unregister_sink(struct userdata *u, uint32_t sinkidx)
 {
     struct pa_policy_groupset *gset;
     struct pa_policy_group    *group;
-    int                        i;
+    struct pa_policy_grouplist *list;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
 
     pa_log_debug("Unregister sink (idx=%d)", sinkidx);
         
-    for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-        for (group = gset->hash_tbl[i];    group;    group = group->next) {
-            if (group->sinkidx == sinkidx) {
-                pa_log_debug("  unset default sink for group '%s'",
-                             group->name);
+    while ((list = groups_at(gset->bysink, sinkidx)) != NULL) {
+        group = list->groups[0];
 
-                group->sink    = NULL;
-                group->sinkidx = PA_IDXSET_INVALID;
+        pa_log_debug("  unset default sink for group '%s'", group->name);
 
-                /* TODO: we should move the streams to somewhere */
-            }
-        }
+        group_set_sink(gset, group, NULL);
+
+        /* TODO: we should move the streams to somewhere */
     }
 }
 
@@ -236,6 +266,44 @@ void pa_policy_groupset_update_sinks(struct userdata *u)
         policy_groupset_register_sink(u, sink, false);
 }
 
+void pa_policy_groupset_update_sink_activity(struct userdata *u,
+                                             struct pa_sink *sink)
+{
+    groupset_update_sink_activity(u, sink, NULL);
+}
+
+void pa_policy_groupset_unlink_sink_activity(struct userdata *u,
+                                             struct pa_sink *sink)
+{
+    pa_assert(sink);
+
+    groupset_update_sink_activity(u, NULL, sink);
+}
+
+static void groupset_update_sink_activity(struct userdata *u,
+                                          struct pa_sink *sink,
+                                          struct pa_sink *unlinked)
+{
+    struct pa_policy_groupset *gset;
+    struct pa_policy_group    *group;
+    uint32_t                   i;
+    bool                       changed = false;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+
+    PA_POLICY_GROUPLIST_FOREACH(group, &gset->bycap[PA_POLICY_GROUP_CAP_DYNAMIC_SINK], i) {
+        if (sink && !(group->sink_match && pa_policy_match(group->sink_match, sink)))
+            continue;
+
+        if (group_update_sink_activity(u, group, unlinked))
+            changed = true;
+    }
+
+    if (changed && u->classify)
+        pa_classify_update_sink_activity(u);
+}
+
 static void policy_groupset_register_source(struct userdata *u,
                                             struct pa_source *source,
                                             bool initial_register)
@@ -244,7 +312,7 @@ static void policy_groupset_register_source(struct userdata *u,
     struct pa_policy_group    *group;
     const char                *srcname;
     uint32_t                   srcidx;
-    int                        i;
+    uint32_t                   i;
 
     pa_assert(u);
     pa_assert(source);
@@ -257,18 +325,15 @@ static void policy_groupset_register_source(struct userdata *u,
         if (initial_register)
             pa_log_debug("Register source '%s' (idx=%d)", srcname, srcidx);
 
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i];    group;    group = group->next) {
-                if (pa_policy_group_source(group, source) &&
-                    group->source != source) {
-                    pa_log_debug("  set source '%s' as default for group '%s'",
-                                 srcname, group->name);
+        PA_POLICY_GROUPLIST_FOREACH(group, &gset->sourcebound, i) {
+            if (pa_policy_group_source(group, source) &&
+                group->source != source) {
+                pa_log_debug("  set source '%s' as default for group '%s'",
+                             srcname, group->name);
 
-                    group->source = source;
-                    group->srcidx = srcidx;
+                group_set_source(gset, group, source);
 
-                    /* TODO: we should move the streams to the source */
-                }
+                /* TODO: we should move the streams to the source */
             }
         }
     }
@@ -284,25 +349,21 @@ void pa_policy_groupset_unregister_source(struct userdata *u, uint32_t srcidx)
 {
     struct pa_policy_groupset *gset;
     struct pa_policy_group    *group;
-    int                        i;
+    struct pa_policy_grouplist *list;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
 
     pa_log_debug("Unregister source (idx=%d)", srcidx);
         
-    for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-        for (group = gset->hash_tbl[i];    group;    group = group->next) {
-            if (group->srcidx == srcidx) {
-                pa_log_debug("  unset default source for group '%s'",
-                             group->name);
-
-                group->source = NULL;
-                group->srcidx = PA_IDXSET_INVALID;
-                
-                /* TODO: we should move the streams to the somwhere */
-            }
-        }
+    while ((list = groups_at(gset->bysource, srcidx)) != NULL) {
+        group = list->groups[0];
+
+        pa_log_debug("  unset default source for group '%s'", group->name);
+
+        group_set_source(gset, group, NULL);
+            
+        /* TODO: we should move the streams to the somwhere */
     }
 }
 
@@ -339,26 +400,56 @@ void pa_policy_groupset_create_default_group(struct userdata *u,
                 (flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) ? "on" : "off");
 
     gset->dflt = pa_policy_group_new(u, name, NULL, 0, NULL, NULL, NULL, 0, NULL, NULL, NULL, flags);
+
+    /* generated after the configuration was read */
+    if (gset->dflt != NULL)
+        pa_classify_bind_group(u, gset->dflt);
 }
 
 int pa_policy_groupset_restore_volume(struct userdata *u, struct pa_sink *sink)
 {
     struct pa_policy_group *group;
-    struct cursor           cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_grouplist *list;
+    uint32_t i;
     int ret = 0;
 
-    if (sink) {
-        while ((group = group_scan(u->groups, &cursor)) != NULL) {
-            if (sink == group->sink) {
-                if (mute_group_locally(u, group, UNMUTE) < 0)
-                    ret = -1;
-            }
+    if (sink && (list = groups_at(u->groups->bysink, sink->index))) {
+        pa_policy_groupset_begin(u);
+
+        PA_POLICY_GROUPLIST_FOREACH(group, list, i) {
+            if (mute_group_locally(u, group, UNMUTE) < 0)
+                ret = -1;
         }
+
+        if (pa_policy_groupset_commit(u) < 0)
+            ret = -1;
     }
 
     return ret;
 }
 
+void pa_policy_groupset_begin(struct userdata *u)
+{
+    pa_assert(u);
+    pa_assert(u->groups);
+
+    u->groups->deferred++;
+}
+
+int pa_policy_groupset_commit(struct userdata *u)
+{
+    struct pa_policy_groupset *gset;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+    pa_assert(gset->deferred > 0);
+
+    if (--gset->deferred > 0)
+        return 0;
+
+    return groupset_apply(u);
+}
+
 struct pa_policy_group *pa_policy_group_new(struct userdata *u, const char *name,
                                             const char *sinkname,
                                             enum pa_classify_method sink_method,
@@ -373,7 +464,7 @@ struct pa_policy_group *pa_policy_group_new(struct userdata *u, const char *name
 {
     struct pa_policy_groupset   *gset;
     struct pa_policy_group      *group;
-    uint32_t                     idx;
+    uint32_t                     i;
     enum pa_policy_object_target obj_target;
 
     pa_assert(u);
@@ -384,7 +475,7 @@ struct pa_policy_group *pa_policy_group_new(struct userdata *u, const char *name
     pa_policy_var_update(u, sinkname);
     pa_policy_var_update(u, srcname);
 
-    if ((group = find_group_by_name(gset, name, &idx)) != NULL)
+    if ((group = find_group_by_name(gset, name)) != NULL)
         return group;
 
     group = pa_xnew0(struct pa_policy_group, 1);
@@ -421,21 +512,47 @@ struct pa_policy_group *pa_policy_group_new(struct userdata *u, const char *name
         }
     }
 
-    group->next     = gset->hash_tbl[idx];
     group->flags    = flags;
     group->name     = pa_xstrdup(name);
     group->limit    = PA_VOLUME_NORM;
 
     group->sinkname = sinkname ? pa_xstrdup(sinkname) : NULL;
-    group->sink     = sinkname ? NULL : defsink;
-    group->sinkidx  = sinkname ? PA_IDXSET_INVALID : defsinkidx;
+    group->sinkidx  = PA_IDXSET_INVALID;
+    group_set_sink(gset, group, sinkname ? NULL : defsink);
 
     group->srcname  = srcname  ? pa_xstrdup(srcname) : NULL;
-    group->source   = srcname  ? NULL : defsource;
-    group->srcidx   = srcname  ? PA_IDXSET_INVALID : defsrcidx;
+    group->srcidx   = PA_IDXSET_INVALID;
+    group_set_source(gset, group, srcname ? NULL : defsource);
     group->properties = properties;
 
-    gset->hash_tbl[idx] = group;
+    grouplist_add(&gset->all, group);
+
+    if (group->sinkname || group->sink_match)
+        grouplist_add(&gset->sinkbound, group);
+    if (group->srcname || group->src_match)
+        grouplist_add(&gset->sourcebound, group);
+
+    for (i = 0;  i < PA_POLICY_GROUP_CAP_MAX;  i++) {
+        if (flags & cap_flags[i])
+            grouplist_add(&gset->bycap[i], group);
+    }
+
+    group->atom = pa_policy_atom_intern(name);
+
+    if (group->atom >= gset->natom) {
+        i = gset->natom;
+        gset->natom  = group->atom + 16;
+        gset->byatom = pa_xrenew(struct pa_policy_group *, gset->byatom, gset->natom);
+        memset(gset->byatom + i, 0, sizeof(*gset->byatom) * (gset->natom - i));
+    }
+
+    gset->byatom[group->atom] = group;
+
+    if (!strcmp(name, PA_POLICY_DEFAULT_GROUP_NAME))
+        gset->dflt = group;
+
+    if (flags & PA_POLICY_GROUP_FLAG_DYNAMIC_SINK)
+        group_update_sink_activity(u, group, NULL);
 
     pa_log_info("created group (%s|%d|%s|0x%04x)", group->name,
                 (group->limit * 100) / PA_VOLUME_NORM,
@@ -454,88 +571,83 @@ void pa_policy_group_free(struct pa_policy_groupset *gset, const char *name)
 {
     struct pa_policy_group       *group;
     struct pa_policy_group       *dflt;
-    struct pa_policy_group       *prev;
-    struct pa_sink_input         *sinp;
-    struct pa_sink_input_list    *sil;
-    struct pa_sink_input_list    *nxtsi;
-    struct pa_source_output      *sout;
-    struct pa_source_output_list *sol;
-    struct pa_source_output_list *nxtso;
-    char                         *dnam;
-    uint32_t                      idx;
+    struct pa_sink_input           *sinp;
+    struct pa_sink_input_member    *sil;
+    struct pa_source_output        *sout;
+    struct pa_source_output_member *sol;
+    char                           *dnam;
+    int                             i;
 
     pa_assert(gset);
     pa_assert(name);
 
-    if ((group = find_group_by_name(gset, name, &idx)) != NULL) {
-        for (prev = (struct pa_policy_group *)&gset->hash_tbl[idx];
-             prev->next != NULL;
-             prev = prev->next)
-        {
-            if (group == prev->next) {
-                if (group->sinpls != NULL) {
-                    dflt = gset->dflt;
-
-                    if (group == dflt) {
-                        /*
-                         * If the default group is going to be deleted,
-                         * release all sink-inputs
-                         */
-                        for (sil = group->sinpls;   sil;   sil = nxtsi) {
-                            nxtsi = sil->next;
-                            sinp  = sil->sink_input;
-
-                            pa_sink_input_ext_set_policy_group(sinp, NULL);
-
-                            pa_xfree(sil);
-                        }
-                    }
-                    else {
-                        /*
-                         * Otherwise add the sink-inputs to the default group
-                         */
-                        dnam = dflt->name;
-
-                        for (sil = group->sinpls;   sil;   sil = sil->next) {
-                            sinp = sil->sink_input;
-
-                            pa_sink_input_ext_set_policy_group(sinp, dnam);
-                            
-                            if (sil->next == NULL)
-                                sil->next = dflt->sinpls;
-                        }
-                        
-                        dflt->sinpls = group->sinpls;
-                    }
-                } /* if group->sinpls != NULL */
+    if ((group = find_group_by_name(gset, name)) != NULL) {
+        if (group->sinpcnt > 0) {
+            dflt = gset->dflt;
 
-                if (group->soutls != NULL) {
-                    for (sol = group->soutls;  sol;  sol = nxtso) {
-                        nxtso = sol->next;
-                        sout  = sol->source_output;
+            if (group == dflt) {
+                /*
+                 * If the default group is going to be deleted,
+                 * release all sink-inputs
+                 */
+                PA_POLICY_GROUP_FOREACH_SINK_INPUT(sil, group, i) {
+                    sinp = sil->sink_input;
 
-                        pa_source_output_ext_set_policy_group(sout, NULL);
+                    pa_sink_input_ext_set_policy_group(sinp, NULL);
 
-                        pa_xfree(sol);
-                    }
-                } /* if group->soutls */
+                    sil->group = NULL;
+                }
+            }
+            else {
+                /*
+                 * Otherwise add the sink-inputs to the default group
+                 */
+                dnam = dflt->name;
+
+                PA_POLICY_GROUP_FOREACH_SINK_INPUT(sil, group, i) {
+                    sinp = sil->sink_input;
+
+                    pa_sink_input_ext_set_policy_group(sinp, dnam);
+                    
+                    sinp_member_add(dflt, sil);
+                }
+            }
+        } /* if group->sinpcnt > 0 */
+
+        if (group->soutcnt > 0) {
+            PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(sol, group, i) {
+                sout = sol->source_output;
 
-                pa_xfree(group->name);
-                pa_xfree(group->sinkname);
-                pa_xfree(group->portname);
-                pa_policy_match_free(group->sink_match);
-                pa_xfree(group->srcname);
-                pa_policy_match_free(group->src_match);
-                if (group->properties)
-                    pa_proplist_free(group->properties);
+                pa_source_output_ext_set_policy_group(sout, NULL);
 
-                prev->next = group->next;
+                sol->group = NULL;
+            }
+        } /* if group->soutcnt > 0 */
 
-                pa_xfree(group);
+        group_set_sink(gset, group, NULL);
+        group_set_source(gset, group, NULL);
+        grouplist_remove(&gset->all, group);
+        grouplist_remove(&gset->sinkbound, group);
+        grouplist_remove(&gset->sourcebound, group);
 
-                break;
-            } 
-        } /* for */
+        for (i = 0;  i < PA_POLICY_GROUP_CAP_MAX;  i++)
+            grouplist_remove(&gset->bycap[i], group);
+
+        pa_xfree(group->sinps);
+        pa_xfree(group->souts);
+
+        gset->byatom[group->atom] = NULL;
+
+        pa_xfree(group->name);
+        pa_xfree(group->sinkname);
+        pa_xfree(group->portname);
+        pa_policy_match_free(group->sink_match);
+        pa_xfree(group->srcname);
+        pa_policy_match_free(group->src_match);
+        if (group->properties)
+            pa_proplist_free(group->properties);
+
+        pa_xfree(group);
     } /* if find_group */
 }
 
@@ -548,13 +660,94 @@ struct pa_policy_group *pa_policy_group_find(struct userdata *u,
     assert((gset = u->groups));
     assert(name);
 
-    return find_group_by_name(gset, name, NULL);
+    return find_group_by_name(gset, name);
+}
+
+struct pa_policy_group *pa_policy_group_find_atom(struct userdata *u,
+                                                  pa_policy_atom atom)
+{
+    struct pa_policy_groupset *gset;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+
+    if (atom >= gset->natom)
+        return NULL;
+
+    return gset->byatom[atom];
+}
+
+/*
+ * Group members are kept in arrays for the loops over the groups. Each
+ * member knows its position in the array, so it can be removed in O(1)
+ * by moving the last member to its place.
+ */
+static void sinp_member_add(struct pa_policy_group *group,
+                            struct pa_sink_input_member *member)
+{
+    if (group->sinpcnt >= group->sinpsize) {
+        group->sinpsize = group->sinpsize ? group->sinpsize * 2 : 8;
+        group->sinps = pa_xrenew(struct pa_sink_input_member *,
+                                 group->sinps, group->sinpsize);
+    }
+
+    member->group = group;
+    member->pos   = group->sinpcnt;
+
+    group->sinps[group->sinpcnt++] = member;
+}
+
+static void sinp_member_remove(struct pa_sink_input_member *member)
+{
+    struct pa_policy_group *group = member->group;
+    struct pa_sink_input_member *last;
+
+    pa_assert(group);
+    pa_assert(member->pos < group->sinpcnt);
+    pa_assert(group->sinps[member->pos] == member);
+
+    last = group->sinps[--group->sinpcnt];
+    last->pos = member->pos;
+    group->sinps[member->pos] = last;
+
+    member->group = NULL;
+}
+
+static void sout_member_add(struct pa_policy_group *group,
+                            struct pa_source_output_member *member)
+{
+    if (group->soutcnt >= group->soutsize) {
+        group->soutsize = group->soutsize ? group->soutsize * 2 : 8;
+        group->souts = pa_xrenew(struct pa_source_output_member *,
+                                 group->souts, group->soutsize);
+    }
+
+    member->group = group;
+    member->pos   = group->soutcnt;
+
+    group->souts[group->soutcnt++] = member;
+}
+
+static void sout_member_remove(struct pa_source_output_member *member)
+{
+    struct pa_policy_group *group = member->group;
+    struct pa_source_output_member *last;
+
+    pa_assert(group);
+    pa_assert(member->pos < group->soutcnt);
+    pa_assert(group->souts[member->pos] == member);
+
+    last = group->souts[--group->soutcnt];
+    last->pos = member->pos;
+    group->souts[member->pos] = last;
+
+    member->group = NULL;
 }
 
-void pa_policy_group_insert_sink_input(struct userdata      *u,
-                                       const char           *name,
-                                       struct pa_sink_input *si,
-                                       uint32_t              flags)
+void pa_policy_group_insert_sink_input(struct userdata        *u,
+                                       struct pa_policy_group *grp,
+                                       struct pa_sink_input   *si,
+                                       uint32_t                flags)
 {
     static const char *media        = "audio_playback";
     static uint32_t    route_flags  = PA_POLICY_GROUP_FLAG_SET_SINK |
@@ -563,33 +756,33 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
 
     struct pa_policy_groupset *gset;
     struct pa_policy_group    *group, *g;
-    struct pa_sink_input_list *sl;
+    struct pa_sink_input_ext  *ext;
     struct pa_null_sink       *ns;
     const char                *sinp_name;
     const char                *sink_name;
     int                        local_route;
     int                        local_mute;
     int                        static_route;
-    struct cursor              cursor = { .idx = 0, .grp = NULL, };
+    int                        corked;
+    pa_volume_t                limit;
+    struct pa_policy_grouplist *list;
+    uint32_t                   j;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
     pa_assert(si);
 
-    if (name == NULL)
-        group = gset->dflt;
-    else
-        group = find_group_by_name(gset, name, NULL);
+    group = grp ? grp : gset->dflt;
 
     if (group != NULL) {
         pa_sink_input_ext_set_policy_group(si, group->name);
 
-        sl = pa_xnew0(struct pa_sink_input_list, 1);
-        sl->next = group->sinpls;
-        sl->index = si->index;
-        sl->sink_input = si;
+        pa_assert_se((ext = pa_sink_input_ext_lookup(u, si)));
+
+        ext->member.index = si->index;
+        ext->member.sink_input = si;
 
-        group->sinpls = sl;
+        sinp_member_add(group, &ext->member);
 
         if (group->sink != NULL) {
             sinp_name = pa_sink_input_ext_get_name(si);
@@ -605,6 +798,7 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
                              sinp_name, ns->name);
 
                 pa_sink_input_move_to(si, ns->sink, true);
+                pa_sink_ext_null_sink_update_suspend(u, NULL);
             }
             else if (group->flags & route_flags) {
                 static_route = ((group->flags & route_flags) == setsink_flag);
@@ -621,27 +815,32 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
 
 
             if (group->flags & PA_POLICY_GROUP_FLAG_CORK_STREAM) {
-                if (pa_sink_input_ext_cork(u, si, group->corked))
-                    pa_log_debug("stream '%s'/'%s' %scorked", group->name, sinp_name, group->corked ? "" : "un");
+                corked = group->corked || group->mutebyvol;
+
+                if (pa_sink_input_ext_cork(u, si, corked))
+                    pa_log_debug("stream '%s'/'%s' %scorked", group->name, sinp_name, corked ? "" : "un");
             }
 
-            if (local_mute) {
-                while ((g = group_scan(u->groups, &cursor)) != NULL){
-                    if (g->sink && g->sink == group->sink) {
-                        mute_group_locally(u, g, MUTE);
-                    }
-                }
+            if (local_mute &&
+                (list = groups_at(gset->bysink, group->sink->index)) != NULL)
+            {
+                pa_policy_groupset_begin(u);
+
+                PA_POLICY_GROUPLIST_FOREACH(g, list, j)
+                    mute_group_locally(u, g, MUTE);
+
+                pa_policy_groupset_commit(u);
             }
             else if (group->flags & PA_POLICY_GROUP_FLAG_LIMIT_VOLUME) {
+                limit = group->mutebyvol ? 0 : group->limit;
+
                 pa_log_debug("set volume limit %d for sink input '%s'",
-                             (group->limit * 100) / PA_VOLUME_NORM,sinp_name);
+                             (limit * 100) / PA_VOLUME_NORM, sinp_name);
 
-                pa_sink_input_ext_set_volume_limit(u, si, group->limit);
+                pa_sink_input_ext_set_volume_limit(u, si, limit);
             }
         }
 
-        group->sinpcnt++;
-
         if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
             group->sinpcnt == 1)
         {
@@ -659,58 +858,47 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
 
 void pa_policy_group_remove_sink_input(struct userdata *u, uint32_t idx)
 {
-    static const char         *media = "audio_playback";
-    struct pa_policy_group    *group;
-    struct pa_sink_input_list *prev;
-    struct pa_sink_input_list *sl;
-    struct cursor              cursor = { .idx = 0, .grp = NULL, };
+    static const char           *media = "audio_playback";
+    struct pa_policy_group      *group;
+    struct pa_sink_input_ext    *ext;
+    struct pa_sink_input_member *sl;
 
     pa_assert(u);
     pa_assert(u->groups);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        for (prev = (struct pa_sink_input_list *)&group->sinpls;
-             prev != NULL;
-             prev = prev->next)
-        {
-            if ((sl = prev->next) != NULL && idx == sl->index) {
-
-                group->sinpcnt--;
-
-                if (group->num_moving > 0 && !sl->sink_input->sink) {
-                    pa_log_info("Removing a moving sink input %s",
-                                pa_sink_input_ext_get_name(sl->sink_input));
-                    group->num_moving--;
-                }
-
-                if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
-                    group->sinpcnt < 1)
-                {
-                    group->sinpcnt = 0;
-
-                    pa_log_debug("media notification: group '%s' media '%s' "
-                                 "state 'inactive'", group->name, media);
+    if ((ext = pa_index_hash_lookup(u->hsi, idx)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+    {
+        pa_log("Can't remove sink input (idx=%d): not a member of any group",
+               idx);
+        return;
+    }
 
-                    pa_policy_dbusif_send_media_status(u, media,group->name,0);
-                }
+    sinp_member_remove(sl);
 
-                prev->next = sl->next;
+    if (group->num_moving > 0 && !sl->sink_input->sink) {
+        pa_log_info("Removing a moving sink input %s",
+                    pa_sink_input_ext_get_name(sl->sink_input));
+        group->num_moving--;
+    }
 
-                pa_xfree(sl);
+    pa_sink_ext_null_sink_update_suspend(u, sl->sink_input);
 
-                pa_log_debug("sink input (idx=%d) removed from group '%s'",
-                             idx, group->name);
+    if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
+        group->sinpcnt < 1)
+    {
+        pa_log_debug("media notification: group '%s' media '%s' "
+                     "state 'inactive'", group->name, media);
 
-                return;
-            }
-        }
+        pa_policy_dbusif_send_media_status(u, media,group->name,0);
     }
 
-    pa_log("Can't remove sink input (idx=%d): not a member of any group", idx);
+    pa_log_debug("sink input (idx=%d) removed from group '%s'",
+                 idx, group->name);
 }
 
 void pa_policy_group_insert_source_output(struct userdata         *u,
-                                          const char              *name,
+                                          struct pa_policy_group  *grp,
                                           struct pa_source_output *so)
 {
     static const char  *media       = "audio_recording";
@@ -720,9 +908,10 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
 #endif
 
     struct pa_policy_groupset    *gset;
-    struct pa_policy_group       *group;
-    struct pa_source_output_list *sl;
-    struct pa_null_source        *ns;
+    struct pa_policy_group         *group;
+    struct pa_source_output_ext    *ext;
+    struct pa_source_output_member *sl;
+    struct pa_null_source          *ns;
     const char                   *sout_name;
     const char                   *src_name;
 
@@ -731,20 +920,18 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
     pa_assert_se((gset = u->groups));
     pa_assert(so);
 
-    if (name == NULL)
-        group = gset->dflt;
-    else
-        group = find_group_by_name(gset, name, NULL);
+    group = grp ? grp : gset->dflt;
 
     if (group != NULL) {
         pa_source_output_ext_set_policy_group(so, group->name);
 
-        sl = pa_xnew0(struct pa_source_output_list, 1);
-        sl->next = group->soutls;
+        pa_assert_se((ext = pa_source_output_ext_lookup(u, so)));
+
+        sl = &ext->member;
         sl->index = so->index;
         sl->source_output = so;
 
-        group->soutls = sl;
+        sout_member_add(group, sl);
         ns = u->nullsource;
 
         if (group->mutebyrt_source && ns->source) {
@@ -753,6 +940,11 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
                          sout_name, ns->name);
 
             pa_source_output_move_to(so, ns->source, true);
+        } else if (group->mutebyvol) {
+            pa_log_debug("mute source output '%s' in place",
+                         pa_source_output_ext_get_name(so));
+
+            pa_source_output_set_mute(so, true, false);
         } else if (group->source != NULL) {
             sout_name = pa_source_output_ext_get_name(so);
             src_name  = pa_source_ext_get_name(group->source);
@@ -765,8 +957,6 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
             }
         }
 
-        group->soutcnt++;
-
         if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
             group->soutcnt == 1)
         {
@@ -786,53 +976,40 @@ void pa_policy_group_remove_source_output(struct userdata *u, uint32_t idx)
 {
     static const char  *media       = "audio_recording";
 
-    struct pa_policy_group       *group;
-    struct pa_source_output_list *prev;
-    struct pa_source_output_list *sl;
-    struct cursor                 cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_group         *group;
+    struct pa_source_output_ext    *ext;
+    struct pa_source_output_member *sl;
 
     pa_assert(u);
     pa_assert(u->groups);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        for (prev = (struct pa_source_output_list *)&group->soutls;
-             prev != NULL;
-             prev = prev->next)
-        {
-            if ((sl = prev->next) != NULL && idx == sl->index) {
-                group->soutcnt--;
-
-                if (group->num_moving > 0 && !sl->source_output->source) {
-                    pa_log_info("Removing a moving source output %s",
-                                pa_source_output_ext_get_name(sl->source_output));
-                    group->num_moving--;
-                }
-
-                if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
-                    group->soutcnt < 1)
-                {
-                    group->soutcnt = 0;
-
-                    pa_log_debug("media notification: group '%s' media '%s' "
-                                 "state 'inactive'", group->name, media);
-
-                    pa_policy_dbusif_send_media_status(u, media,group->name,0);
-                }
+    if ((ext = pa_index_hash_lookup(u->hso, idx)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+    {
+        pa_log("Can't remove source output (idx=%d): "
+               "not a member of any group", idx);
+        return;
+    }
 
-                prev->next = sl->next;
+    sout_member_remove(sl);
 
-                pa_xfree(sl);
+    if (group->num_moving > 0 && !sl->source_output->source) {
+        pa_log_info("Removing a moving source output %s",
+                    pa_source_output_ext_get_name(sl->source_output));
+        group->num_moving--;
+    }
 
-                pa_log_debug("source output (idx=%d) removed from group '%s'",
-                             idx, group->name);
+    if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
+        group->soutcnt < 1)
+    {
+        pa_log_debug("media notification: group '%s' media '%s' "
+                     "state 'inactive'", group->name, media);
 
-                return;
-            }
-        }
+        pa_policy_dbusif_send_media_status(u, media,group->name,0);
     }
 
-    pa_log("Can't remove source output (idx=%d): "
-           "not a member of any group", idx);
+    pa_log_debug("source output (idx=%d) removed from group '%s'",
+                 idx, group->name);
 }
 
 int pa_policy_group_move_to(struct userdata *u, const char *name,
@@ -845,7 +1022,8 @@ int pa_policy_group_move_to(struct userdata *u, const char *name,
     struct target             target;
     bool                 target_is_sink = false;
     int                       ret = -1;
-    struct cursor             cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_grouplist *routed;
+    uint32_t                  i;
 
     pa_assert(u);
 
@@ -877,23 +1055,22 @@ int pa_policy_group_move_to(struct userdata *u, const char *name,
                target_is_sink ? "sink" : "source", type, name);
     } else {
         if (name) {             /* move the specified group only */
-            if ((grp = find_group_by_name(u->groups, name, NULL)) != NULL) {
+            if ((grp = find_group_by_name(u->groups, name)) != NULL) {
                 if (!(grp->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO))
                     ret = 0;
                 else
-                    ret = move_group(grp, &target) == 0 ? 1 : -1;
+                    ret = move_group(u->groups, grp, &target) == 0 ? 1 : -1;
             }
         }
         else {                  /* move all groups */
             ret = 0;
+            routed = &u->groups->bycap[PA_POLICY_GROUP_CAP_ROUTE_AUDIO];
 
-           while ((grp = group_scan(u->groups, &cursor)) != NULL) {
-                if ((grp->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO)) {
-                    if (move_group(grp, &target) < 0)
-                        ret = -1;
-                    else
-                        ret++;
-                }
+            PA_POLICY_GROUPLIST_FOREACH(grp, routed, i) {
+                if (move_group(u->groups, grp, &target) < 0)
+                    ret = -1;
+                else
+                    ret++;
             }
         }
     }
@@ -920,37 +1097,66 @@ int pa_policy_group_move_to(struct userdata *u, const char *name,
     return ret;
 }
 
-static int start_move_group(struct pa_policy_group *group)
+static int start_move_group(struct pa_policy_group *group,
+                            struct pa_policy_route_plan *plan)
 {
-    struct pa_sink_input_list    *input  = NULL;
-    struct pa_source_output_list *output = NULL;
+    int i;
+    struct pa_sink_input_member    *input  = NULL;
+    struct pa_source_output_member *output = NULL;
+    struct pa_sink                 *sink;
+    struct pa_source               *source;
+    bool                            stays;
 
     pa_assert(group);
+    pa_assert(plan);
 
     if (group->num_moving > 0)
         pa_log_error("Starting to move group %s which already has moving streams", group->name);
 
-    for (input = group->sinpls; input; input = input->next) {
-        if (!input->sink_input->sink)
+    PA_POLICY_GROUP_FOREACH_SINK_INPUT(input, group, i) {
+        if (!(sink = input->sink_input->sink)) {
             pa_log_error("Sink input %s already detached",
                     pa_sink_input_ext_get_name(input->sink_input));
+            continue;
+        }
+
+        /* Streams muted by route sit on the null sink and stay there. */
+        stays = group->mutebyrt_sink ||
+                !plan->changed[pa_policy_route_to_sink] ||
+                sink == plan->target[pa_policy_route_to_sink];
+
+        if (stays && (!sink->card ||
+                      !pa_idxset_get_by_data(plan->cards, sink->card, NULL)))
+            plan->kept++;
         else {
             pa_log_debug("Starting to move sink input %s",
                     pa_sink_input_ext_get_name(input->sink_input));
             pa_assert_se(pa_sink_input_start_move(input->sink_input) >= 0);
             group->num_moving++;
+            plan->detached++;
         }
     }
 
-    for (output = group->soutls; output; output = output->next) {
-        if (!output->source_output->source)
+    PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(output, group, i) {
+        if (!(source = output->source_output->source)) {
             pa_log_error("Source output %s already detached",
                     pa_source_output_ext_get_name(output->source_output));
+            continue;
+        }
+
+        stays = group->mutebyrt_source ||
+                !plan->changed[pa_policy_route_to_source] ||
+                source == plan->target[pa_policy_route_to_source];
+
+        if (stays && (!source->card ||
+                      !pa_idxset_get_by_data(plan->cards, source->card, NULL)))
+            plan->kept++;
         else {
             pa_log_debug("Starting to move source output %s",
                     pa_source_output_ext_get_name(output->source_output));
             pa_assert_se(pa_source_output_start_move(output->source_output) >= 0);
             group->num_moving++;
+            plan->detached++;
         }
     }
 
@@ -959,24 +1165,25 @@ static int start_move_group(struct pa_policy_group *group)
 
 void pa_policy_group_assert_moving(struct userdata *u)
 {
-    struct pa_sink_input_list      *sil;
-    struct pa_source_output_list   *sol;
+    int i;
+    struct pa_sink_input_member      *sil;
+    struct pa_source_output_member   *sol;
     struct pa_policy_group         *group = NULL;
-    struct cursor                   cursor = { .idx = 0, .grp = NULL, };
+    uint32_t                        j;
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
+    PA_POLICY_GROUPLIST_FOREACH(group, &u->groups->all, j) {
         /* Test that the group has no moving streams */
         if (group->num_moving > 0) {
             pa_log_error("Group %s still has %d moving streams",
                          group->name, group->num_moving);
 
-            for (sil = group->sinpls; sil; sil = sil->next) {
+            PA_POLICY_GROUP_FOREACH_SINK_INPUT(sil, group, i) {
                 if (!sil->sink_input->sink)
                     pa_log_error("Sink input %s still moving",
                                  pa_sink_input_ext_get_name(sil->sink_input));
             }
 
-            for (sol = group->soutls; sol; sol = sol->next) {
+            PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(sol, group, i) {
                 if (!sol->source_output->source)
                     pa_log_error("Source output %s still moving",
                                  pa_source_output_ext_get_name(sol->source_output));
@@ -985,23 +1192,24 @@ void pa_policy_group_assert_moving(struct userdata *u)
     }
 }
 
-int pa_policy_group_start_move_all(struct userdata *u)
+int pa_policy_group_start_move_planned(struct userdata *u,
+                                       struct pa_policy_route_plan *plan)
 {
     struct pa_policy_group *group = NULL;
-    struct cursor           cursor = { .idx = 0, .grp = NULL, };
-    int ret = 0;
+    struct pa_policy_grouplist *routed;
+    uint32_t i;
 
     pa_assert(u);
+    pa_assert(u->groups);
+    pa_assert(plan);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        if (group->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO) {
-            start_move_group(group);
-            ret++;
-            pa_assert(group->num_moving > 0 || group->sinpcnt + group->soutcnt == 0);
-        }
-    }
+    u->groups->nmoved = 0;
+    routed = &u->groups->bycap[PA_POLICY_GROUP_CAP_ROUTE_AUDIO];
 
-    return ret;
+    PA_POLICY_GROUPLIST_FOREACH(group, routed, i)
+        start_move_group(group, plan);
+
+    return routed->count;
 }
 
 int pa_policy_group_cork(struct userdata *u, const char *name, int corked)
@@ -1011,7 +1219,7 @@ int pa_policy_group_cork(struct userdata *u, const char *name, int corked)
 
     pa_assert(u);
 
-    if ((grp = find_group_by_name(u->groups, name, NULL)) == NULL)
+    if ((grp = find_group_by_name(u->groups, name)) == NULL)
         ret = -1;
     else {
         if (!(grp->flags & PA_POLICY_GROUP_FLAG_CORK_STREAM))
@@ -1039,7 +1247,7 @@ int pa_policy_group_volume_limit(struct userdata *u, const char *name,
     if (name == NULL)
         group = gset->dflt;
     else
-        group = find_group_by_name(gset, name, NULL);
+        group = find_group_by_name(gset, name);
 
     if (group == NULL) {
         pa_log("can't set volume limit: don't know group '%s'",
@@ -1052,7 +1260,14 @@ int pa_policy_group_volume_limit(struct userdata *u, const char *name,
         if (!(group->flags & PA_POLICY_GROUP_FLAG_LIMIT_VOLUME))
             ret = 0;
         else {
-            if (!(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE))
+            if (group->flags & PA_POLICY_GROUP_FLAG_MUTE_IN_PLACE) {
+                mute = percent > 0 ? false : true;
+                ret  = mute_group_in_place(u, group, mute);
+
+                if (!mute)
+                    volset_group(u, group, percent);
+            }
+            else if (!(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE))
                 ret = volset_group(u, group, percent);
             else {
                 if (ns->sink == NULL)
@@ -1071,37 +1286,112 @@ int pa_policy_group_volume_limit(struct userdata *u, const char *name,
     return ret;
 }
 
-static struct pa_policy_group *group_scan(struct pa_policy_groupset *gset,
-                                          struct cursor *cursor)
+static void grouplist_add(struct pa_policy_grouplist *list,
+                          struct pa_policy_group *group)
 {
-    struct pa_policy_group *grp;
+    if (list->count >= list->size) {
+        list->size = list->size ? list->size * 2 : 8;
+        list->groups = pa_xrenew(struct pa_policy_group *, list->groups,
+                                 list->size);
+    }
 
-    pa_assert(gset);
-    pa_assert(cursor);
+    list->groups[list->count++] = group;
+}
 
-    for (;;) {
-        if (cursor->grp) {
-            grp = cursor->grp;
-            cursor->grp = grp->next;
-            return grp;
+static void grouplist_remove(struct pa_policy_grouplist *list,
+                             struct pa_policy_group *group)
+{
+    uint32_t i;
+
+    for (i = 0;  i < list->count;  i++) {
+        if (list->groups[i] == group) {
+            memmove(list->groups + i, list->groups + i + 1,
+                    sizeof(*list->groups) * (list->count - i - 1));
+            list->count--;
+            return;
         }
+    }
+}
+
+static void grouplist_free(void *data)
+{
+    struct pa_policy_grouplist *list = data;
+
+    pa_xfree(list->groups);
+    pa_xfree(list);
+}
+
+/* Return the groups routed to the sink or source of the given index in
+ * map, or NULL if there are none. */
+static struct pa_policy_grouplist *groups_at(pa_hashmap *map, uint32_t idx)
+{
+    if (idx == PA_IDXSET_INVALID)
+        return NULL;
 
-        if (cursor->idx >= PA_POLICY_GROUP_HASH_DIM)
-            return NULL;
+    return pa_hashmap_get(map, PA_UINT32_TO_PTR(idx));
+}
+
+static void groups_move(pa_hashmap *map, struct pa_policy_group *group,
+                        uint32_t from, uint32_t to)
+{
+    struct pa_policy_grouplist *list;
 
-        while (cursor->idx < PA_POLICY_GROUP_HASH_DIM &&
-               (cursor->grp = gset->hash_tbl[cursor->idx++]) == NULL)
-            ;
+    if ((list = groups_at(map, from)) != NULL) {
+        grouplist_remove(list, group);
+
+        if (list->count == 0)
+            pa_hashmap_remove_and_free(map, PA_UINT32_TO_PTR(from));
+    }
+
+    if (to != PA_IDXSET_INVALID) {
+        if ((list = groups_at(map, to)) == NULL) {
+            list = pa_xnew0(struct pa_policy_grouplist, 1);
+            pa_hashmap_put(map, PA_UINT32_TO_PTR(to), list);
+        }
+
+        grouplist_add(list, group);
     }
 }
 
+static void group_set_sink(struct pa_policy_groupset *gset,
+                           struct pa_policy_group *group,
+                           struct pa_sink *sink)
+{
+    uint32_t sinkidx = sink ? sink->index : PA_IDXSET_INVALID;
+
+    if (group->sink == sink && group->sinkidx == sinkidx)
+        return;
+
+    groups_move(gset->bysink, group, group->sinkidx, sinkidx);
+
+    group->sink    = sink;
+    group->sinkidx = sinkidx;
+}
+
+static void group_set_source(struct pa_policy_groupset *gset,
+                             struct pa_policy_group *group,
+                             struct pa_source *source)
+{
+    uint32_t srcidx = source ? source->index : PA_IDXSET_INVALID;
+
+    if (group->source == source && group->srcidx == srcidx)
+        return;
 
-static int move_group(struct pa_policy_group *group, struct target *target)
+    groups_move(gset->bysource, group, group->srcidx, srcidx);
+
+    group->source = source;
+    group->srcidx = srcidx;
+}
+
+
+static int move_group(struct pa_policy_groupset *gset,
+                      struct pa_policy_group *group, struct target *target)
 {
+    int i;
     struct pa_sink               *sink;
     struct pa_source             *source;
-    struct pa_sink_input_list    *sil;
-    struct pa_source_output_list *sol;
+    struct pa_sink_input_member    *sil;
+    struct pa_source_output_member *sol;
     struct pa_sink_input         *sinp;
     struct pa_source_output      *sout;
     const char                   *sinkname;
@@ -1123,30 +1413,41 @@ static int move_group(struct pa_policy_group *group, struct target *target)
                              group->name, sinkname);
             }
         } else {
+            /* the group gets a sink name of its own; rebind it by name
+             * when the sink is re-created */
+            if (!group->sinkname && !group->sink_match)
+                grouplist_add(&gset->sinkbound, group);
+
             pa_xfree(group->sinkname);
             group->sinkname = pa_xstrdup(sinkname);
-            group->sink = sink;
-            group->sinkidx = sink->index;
+            group_set_sink(gset, group, sink);
 
             if (!group->mutebyrt_sink) {
-                for (sil = group->sinpls; sil; sil = sil->next) {
+                PA_POLICY_GROUP_FOREACH_SINK_INPUT(sil, group, i) {
                     sinp = sil->sink_input;
 
+                    if (sinp->sink == sink)
+                        continue;
+
                     pa_log_debug("move sink input '%s' to sink '%s'",
                                  pa_sink_input_ext_get_name(sinp),
                                  sinkname);
 
                     if (!sinp->sink) {
                         pa_assert(group->num_moving > 0);
-                        if (pa_sink_input_finish_move(sinp, sink, true) >= 0)
+                        if (pa_sink_input_finish_move(sinp, sink, true) >= 0) {
                             group->num_moving--;
+                            gset->nmoved++;
+                        }
                         else {
                             ret = -1;
                             pa_log_error("Failed to finish moving %s to %s",
                                          pa_sink_input_ext_get_name(sinp),
                                          sinkname);
                         }
-                    } else if (pa_sink_input_move_to(sinp, sink, true) < 0) {
+                    } else if (pa_sink_input_move_to(sinp, sink, true) >= 0)
+                        gset->nmoved++;
+                    else {
                         ret = -1;
                         pa_log_error("Failed to move %s to %s",
                                      pa_sink_input_ext_get_name(sinp),
@@ -1156,7 +1457,7 @@ static int move_group(struct pa_policy_group *group, struct target *target)
             }
         }
 
-        for (sil = group->sinpls; sil; sil = sil->next) {
+        PA_POLICY_GROUP_FOREACH_SINK_INPUT(sil, group, i) {
             sinp = sil->sink_input;
             if (!sinp->sink) {
                 pa_log_debug("Re-attaching %s to %s",
@@ -1168,8 +1469,10 @@ static int move_group(struct pa_policy_group *group, struct target *target)
                                  pa_sink_input_ext_get_name(sinp),
                                  pa_sink_ext_get_name(group->sink));
                 }
-                else
+                else {
                     group->num_moving--;
+                    gset->nmoved++;
+                }
             }
         }
 
@@ -1187,27 +1490,34 @@ static int move_group(struct pa_policy_group *group, struct target *target)
                              group->name, pa_source_ext_get_name(source));
             }
         } else {
-            group->source = source;
+            group_set_source(gset, group, source);
 
             if (!group->mutebyrt_source) {
-                for (sol = group->soutls; sol; sol = sol->next) {
+                PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(sol, group, i) {
                     sout = sol->source_output;
 
+                    if (sout->source == source)
+                        continue;
+
                     pa_log_debug("move source output '%s' to source '%s'",
                                  pa_source_output_ext_get_name(sout),
                                  pa_source_ext_get_name(source));
 
                     if (!sout->source) {
                         pa_assert(group->num_moving > 0);
-                        if (pa_source_output_finish_move(sout, source, true) >= 0)
+                        if (pa_source_output_finish_move(sout, source, true) >= 0) {
                             group->num_moving--;
+                            gset->nmoved++;
+                        }
                         else {
                             ret = -1;
                             pa_log_error("Failed to finish moving %s to %s",
                                          pa_source_output_ext_get_name(sout),
                                          pa_source_ext_get_name(source));
                         }
-                    } else if (pa_source_output_move_to(sout, source, true) < 0) {
+                    } else if (pa_source_output_move_to(sout, source, true) >= 0)
+                        gset->nmoved++;
+                    else {
                         ret = -1;
                         pa_log_error("Failed to move %s to %s",
                                      pa_source_output_ext_get_name(sout),
@@ -1217,7 +1527,7 @@ static int move_group(struct pa_policy_group *group, struct target *target)
             }
         }
 
-        for (sol = group->soutls; sol; sol = sol->next) {
+        PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(sol, group, i) {
             sout = sol->source_output;
             if (!sout->source) {
                 pa_log_debug("Re-attaching %s to %s",
@@ -1228,8 +1538,10 @@ static int move_group(struct pa_policy_group *group, struct target *target)
                     pa_log_error("Failed to re-attach %s to %s",
                                  pa_source_output_ext_get_name(sout),
                                  pa_source_ext_get_name(group->source));
-                } else
+                } else {
                     group->num_moving--;
+                    gset->nmoved++;
+                }
             }
         }
 
@@ -1249,12 +1561,10 @@ static int volset_group(struct userdata        *u,
                         struct pa_policy_group *group,
                         pa_volume_t             percent)
 {
+    int i;
     pa_volume_t limit;
-    struct pa_sink_input_list *sl;
+    struct pa_sink_input_member *sl;
     struct pa_sink_input *sinp;
-    struct pa_sink *sink;
-    struct pa_sink_ext *ext;
-    int vset;
     int retval;
 
     limit  = ((percent > 100 ? 100 : percent) * PA_VOLUME_NORM) / 100;
@@ -1268,24 +1578,16 @@ static int volset_group(struct userdata        *u,
         group->limit = limit;
 
         if (!group->locmute) {
-            for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
+            PA_POLICY_GROUP_FOREACH_SINK_INPUT(sl, group, i) {
                 sinp = sl->sink_input;
-                vset = pa_sink_input_ext_set_volume_limit(u, sinp, limit);
 
-                if (vset < 0)
-                    retval = -1;
-                else {
-                    sink = sinp->sink;
-                    ext  = pa_sink_ext_lookup(u, sink);
-
-                    pa_assert(ext);
-
-                    pa_log_debug("set volume limit %d for sink input '%s'",
-                                 percent, pa_sink_input_ext_get_name(sinp));
+                pa_log_debug("set volume limit %d for sink input '%s'",
+                             percent, pa_sink_input_ext_get_name(sinp));
 
-                    ext->need_volume_setting |= vset;
-                }
+                want_limit(u, sinp, limit);
             }
+
+            retval = groupset_apply(u);
         }
     }
 
@@ -1344,11 +1646,12 @@ static int mute_group_by_route(struct userdata        *u,
                                struct pa_policy_group *group,
                                int                     mute)
 {
-    struct pa_sink_input_list *sl;
+    int i;
+    struct pa_sink_input_member *sl;
     struct pa_sink_input *sinp;
     struct pa_sink *sink;
     const char *sink_name;
-    struct pa_source_output_list *soutls;
+    struct pa_source_output_member *soutls;
     struct pa_source_output *sout;
     struct pa_source *source;
     const char *source_name;
@@ -1382,16 +1685,18 @@ static int mute_group_by_route(struct userdata        *u,
             group->mutebyrt_sink = mute;
 
             if (!group->locmute) {
-                for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
+                PA_POLICY_GROUP_FOREACH_SINK_INPUT(sl, group, i) {
                     sinp = sl->sink_input;
 
                     pa_log_debug("move sink input '%s' to sink '%s' by "
                                  "mute-by-route",
                                  pa_sink_input_ext_get_name(sinp), sink_name);
 
-                    if (pa_sink_input_move_to(sinp, sink, true) < 0)
-                        ret = -1;
+                    want_route(u, sinp, mute);
                 }
+
+                if (groupset_apply(u) < 0)
+                    ret = -1;
             }
         }
     }
@@ -1412,7 +1717,7 @@ static int mute_group_by_route(struct userdata        *u,
             group->mutebyrt_source = mute;
 
             if (!group->locmute) {
-                for (soutls = group->soutls;   soutls != NULL;   soutls = soutls->next) {
+                PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(soutls, group, i) {
                     sout = soutls->source_output;
 
                     pa_log_debug("move source output '%s' to source '%s' by "
@@ -1429,11 +1734,63 @@ static int mute_group_by_route(struct userdata        *u,
     return ret;
 }
 
+/* Mute a group without moving any of its streams: the sink inputs get a
+ * zero volume limit (ie. they are muted) and are corked as well if the
+ * group is allowed to cork its streams. Source outputs are muted. */
+static int mute_group_in_place(struct userdata        *u,
+                               struct pa_policy_group *group,
+                               int                     mute)
+{
+    int i;
+    struct pa_sink_input_member *sl;
+    struct pa_sink_input *sinp;
+    struct pa_source_output_member *soutls;
+    struct pa_source_output *sout;
+    int ret = 0;
+
+    if (mute == group->mutebyvol) {
+        pa_log_debug("group '%s' is already %smuted in place", group->name,
+                     mute ? "" : "un");
+        return 0;
+    }
+
+    pa_log_debug("group '%s' is %smuted in place", group->name,
+                 mute ? "" : "un");
+
+    group->mutebyvol = mute;
+
+    PA_POLICY_GROUP_FOREACH_SINK_INPUT(sl, group, i) {
+        sinp = sl->sink_input;
+
+        if (!group->locmute)
+            want_limit(u, sinp, mute ? 0 : group->limit);
+
+        if (group->flags & PA_POLICY_GROUP_FLAG_CORK_STREAM)
+            want_cork(u, sinp, group->corked || mute);
+    }
+
+    ret = groupset_apply(u);
+
+    PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(soutls, group, i) {
+        sout = soutls->source_output;
+
+        if (sout->muted != (bool)mute) {
+            pa_log_debug("%smute source output '%s' in place",
+                         mute ? "" : "un", pa_source_output_ext_get_name(sout));
+
+            pa_source_output_set_mute(sout, mute, false);
+        }
+    }
+
+    return ret;
+}
+
 static int mute_group_locally(struct userdata        *u,
                               struct pa_policy_group *group,
                               int                     locmute)
 {
-    struct pa_sink_input_list *sl;
+    int i;
+    struct pa_sink_input_member *sl;
     struct pa_sink_input *sinp;
     struct pa_sink_input_ext *ext;
     struct pa_sink *sink;
@@ -1459,7 +1816,7 @@ static int mute_group_locally(struct userdata        *u,
         pa_log_debug("group '%s' locally %smuted%s",group->name,prefix,method);
 
 
-        for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
+        PA_POLICY_GROUP_FOREACH_SINK_INPUT(sl, group, i) {
             sinp = sl->sink_input;
             ext  = pa_sink_input_ext_lookup(u, sinp);
             mark = (ext && ext->local.mute);
@@ -1472,48 +1829,26 @@ static int mute_group_locally(struct userdata        *u,
             if (mutebyrt)
                 volume = group->limit;
             else
-                volume = mute ? 0 : (mark ? PA_VOLUME_NORM : group->limit);
+                volume = (mute || group->mutebyvol) ? 0 :
+                         (mark ? PA_VOLUME_NORM : group->limit);
 
             percent = (volume * 100) / PA_VOLUME_NORM;
 
-            
-            if (mutebyrt && sink && sink != sinp->sink) {
 
+            if (mutebyrt && sink && sink != sinp->sink) {
                 pa_log_debug("moving stream '%s'/'%s' to sink '%s'",
                              group->name, sinp_name, sink_name);
 
-                if (sinp->sink) {
-                    if (pa_sink_input_move_to(sinp, sink, true) < 0)
-                        ret = -1;
-                } else {
-                    pa_log_debug("stream '%s'/'%s' is currently moving. finishing move",
-                            group->name, sinp_name);
-                    if (pa_sink_input_finish_move(sinp, sink, true) < 0)
-                        ret = -1;
-                    else {
-                        pa_assert(group->num_moving > 0);
-                        group->num_moving--;
-                    }
-                }
-
-                if (ret == 0)
-                    pa_log_debug("stream '%s'/'%s' is now at sink '%s'",
-                            group->name, sinp_name, sink_name);
-                else
-                    pa_log_error("failed to move stream'%s'/'%s' to sink '%s'",
-                            group->name, sinp_name, sink_name);
+                want_route(u, sinp, mute);
             }
 
             pa_log_debug("set volume limit %d for sink input '%s'/'%s'",
                          percent, group->name, sinp_name);
 
-            if (pa_sink_input_ext_set_volume_limit(u, sinp, volume) < 0)
-                ret = -1;
-            else {
-                pa_log_debug("now volume limit %d for sink input '%s'/'%s'",
-                             percent, group->name, sinp_name);
-            }
+            want_limit(u, sinp, volume);
         }
+
+        ret = groupset_apply(u);
     }
 
     return ret;
@@ -1522,9 +1857,9 @@ static int mute_group_locally(struct userdata        *u,
 
 static int cork_group(struct userdata *u, struct pa_policy_group *group, int corked)
 {
-    struct pa_sink_input_list *sl;
-    struct pa_sink_input *sinp;
-    bool changed;
+    int i;
+    struct pa_sink_input_member *sl;
+    int ret = 0;
 
 
     if (corked == group->corked) {
@@ -1534,93 +1869,254 @@ static int cork_group(struct userdata *u, struct pa_policy_group *group, int cor
     else {
         group->corked = corked;
 
-        for (sl = group->sinpls;    sl;   sl = sl->next) {
-            sinp = sl->sink_input;
+        PA_POLICY_GROUP_FOREACH_SINK_INPUT(sl, group, i)
+            want_cork(u, sl->sink_input, corked || group->mutebyvol);
 
-            changed = pa_sink_input_ext_cork(u, sinp, corked);
+        ret = groupset_apply(u);
+    }
 
-            if (changed)
-                pa_log_debug("sink input '%s' %s",
-                             pa_sink_input_ext_get_name(sinp),
-                             corked ? "corked" : "uncorked");
+    return ret;
+}
+
+
+static struct pa_sink_input_ext *want_queue(struct userdata *u,
+                                            struct pa_sink_input *sinp)
+{
+    struct pa_policy_groupset *gset = u->groups;
+    struct pa_sink_input_ext  *ext;
+
+    if (!(ext = pa_sink_input_ext_lookup(u, sinp)))
+        return NULL;
+
+    if (!ext->want.queued) {
+        if (gset->nqueue >= gset->queuesize) {
+            gset->queuesize = gset->queuesize ? gset->queuesize * 2 : 16;
+            gset->queue = pa_xrenew(uint32_t, gset->queue, gset->queuesize);
         }
+
+        gset->queue[gset->nqueue++] = sinp->index;
+        ext->want.queued = true;
     }
 
-    return 0;
+    return ext;
+}
+
+static void want_cork(struct userdata *u, struct pa_sink_input *sinp,
+                      bool corked)
+{
+    struct pa_sink_input_ext *ext;
+
+    if ((ext = want_queue(u, sinp))) {
+        ext->want.set   |= PA_SINK_INPUT_EXT_WANT_CORK;
+        ext->want.corked = corked;
+    }
+}
+
+static void want_limit(struct userdata *u, struct pa_sink_input *sinp,
+                       pa_volume_t limit)
+{
+    struct pa_sink_input_ext *ext;
+
+    if ((ext = want_queue(u, sinp))) {
+        ext->want.set  |= PA_SINK_INPUT_EXT_WANT_LIMIT;
+        ext->want.limit = limit;
+    }
+}
+
+static void want_route(struct userdata *u, struct pa_sink_input *sinp,
+                       bool to_null)
+{
+    struct pa_sink_input_ext *ext;
+
+    if ((ext = want_queue(u, sinp))) {
+        ext->want.set    |= PA_SINK_INPUT_EXT_WANT_ROUTE;
+        ext->want.to_null = to_null;
+    }
+}
+
+/* Bring a sink input to its desired state. Return the number of changes
+ * made, or -1 if something failed. */
+static int reconcile_sink_input(struct userdata *u,
+                                struct pa_sink_input_ext *ext)
+{
+    struct pa_policy_group *group;
+    struct pa_sink_input   *sinp;
+    struct pa_sink         *sink;
+    const char             *sinp_name;
+    uint32_t                set;
+    bool                    corked;
+    int                     vset;
+    int                     changes = 0;
+    int                     ret = 0;
+
+    set = ext->want.set;
+    ext->want.set = 0;
+    ext->want.queued = false;
+
+    if (!(sinp = ext->member.sink_input) || !(group = ext->member.group))
+        return 0;
+
+    sinp_name = pa_sink_input_ext_get_name(sinp);
+
+    if (set & PA_SINK_INPUT_EXT_WANT_ROUTE) {
+        sink = ext->want.to_null ? u->nullsink->sink : group->sink;
+
+        if (sink && sink != sinp->sink) {
+            if (sinp->sink) {
+                if (pa_sink_input_move_to(sinp, sink, true) < 0)
+                    ret = -1;
+            } else {
+                pa_log_debug("stream '%s'/'%s' is currently moving. finishing move",
+                        group->name, sinp_name);
+                if (pa_sink_input_finish_move(sinp, sink, true) < 0)
+                    ret = -1;
+                else {
+                    pa_assert(group->num_moving > 0);
+                    group->num_moving--;
+                }
+            }
+
+            if (ret == 0) {
+                pa_log_debug("stream '%s'/'%s' is now at sink '%s'",
+                        group->name, sinp_name, pa_sink_ext_get_name(sink));
+                changes++;
+            }
+            else
+                pa_log_error("failed to move stream'%s'/'%s' to sink '%s'",
+                        group->name, sinp_name, pa_sink_ext_get_name(sink));
+        }
+    }
+
+    if (set & PA_SINK_INPUT_EXT_WANT_LIMIT) {
+        if ((vset = pa_sink_input_ext_set_volume_limit(u, sinp, ext->want.limit)) < 0)
+            ret = -1;
+        else if (vset > 0) {
+            if (sinp->sink)
+                pa_sink_ext_need_volume(u, sinp->sink);
+            changes++;
+        }
+    }
+
+    if (set & PA_SINK_INPUT_EXT_WANT_CORK) {
+        corked = (ext->local.cork_state & PA_SINK_INPUT_EXT_STATE_POLICY) ? true : false;
+
+        if (corked != ext->want.corked &&
+            pa_sink_input_ext_cork(u, sinp, ext->want.corked))
+        {
+            pa_log_debug("sink input '%s' %s", sinp_name,
+                         ext->want.corked ? "corked" : "uncorked");
+            changes++;
+        }
+    }
+
+    return ret < 0 ? -1 : changes;
+}
+
+static int groupset_apply(struct userdata *u)
+{
+    struct pa_policy_groupset *gset;
+    struct pa_sink_input_ext  *ext;
+    uint32_t                   i;
+    int                        changes = 0;
+    int                        sts;
+    int                        ret = 0;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+
+    if (gset->deferred > 0 || gset->nqueue == 0)
+        return 0;
+
+    /* applying a state may queue more sink inputs */
+    for (i = 0;  i < gset->nqueue;  i++) {
+        if ((ext = pa_index_hash_lookup(u->hsi, gset->queue[i])) == NULL ||
+            !ext->want.queued)
+            continue; /* gone meanwhile */
+
+        if ((sts = reconcile_sink_input(u, ext)) < 0)
+            ret = -1;
+        else
+            changes += sts;
+    }
+
+    pa_log_debug("%u sink inputs reconciled, %d changes applied",
+                 gset->nqueue, changes);
+
+    gset->nqueue = 0;
+
+    /* once for each sink whose streams got a new volume factor */
+    pa_sink_ext_set_volumes(u);
+
+    pa_sink_ext_null_sink_update_suspend(u, NULL);
+
+    return ret;
 }
 
 
 static struct pa_policy_group *find_group_by_name(struct pa_policy_groupset *gset,
-                                                  const char *name, uint32_t *ridx)
+                                                  const char *name)
 {
     struct pa_policy_group *group = NULL;
-    uint32_t                idx   = hash_value(name);
+    pa_policy_atom          atom;
     
     pa_assert(gset);
     pa_assert(name);
 
-    for (group = gset->hash_tbl[idx];   group != NULL;  group = group->next) {
-        if (!strcmp(name, group->name))
-            break;
-    }    
+    atom = pa_policy_atom_lookup(name);
 
-    if (ridx != NULL)
-        *ridx = idx;
+    if (atom < gset->natom)
+        group = gset->byatom[atom];
 
     return group;
 }
 
 
-static struct pa_sink *find_sink_by_type(struct userdata *u, const char *type)
+/* The unlinked sink, if any, is still in the core's sink set but it does
+ * not count anymore. */
+static bool group_update_sink_activity(struct userdata *u,
+                                       struct pa_policy_group *group,
+                                       struct pa_sink *unlinked)
 {
-    void            *state = NULL;
-    pa_idxset       *idxset;
-    struct pa_sink  *sink;
+    pa_sink *sink;
+    uint32_t idx;
+    int      active;
 
-    pa_assert(u);
-    pa_assert(type);
-    pa_assert(u->core);
-    pa_assert_se((idxset = u->core->sinks));
+    active = false;
 
-    while ((sink = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_sink_typeof(u, sink, type, NULL))
-            break;
+    if (group->sink_match) {
+        PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
+            if (sink != unlinked && pa_policy_match(group->sink_match, sink)) {
+                active = (sink->state == PA_SINK_RUNNING);
+                break;
+            }
+        }
     }
 
-    return sink;
+    if (active == group->sinkact)
+        return false;
+
+    pa_log_debug("dynamic sink of group '%s' is %srunning", group->name,
+                 active ? "" : "not ");
+
+    group->sinkact = active;
+
+    return true;
 }
 
-static struct pa_source *find_source_by_type(struct userdata *u, const char *type)
+static struct pa_sink *find_sink_by_type(struct userdata *u, const char *type)
 {
-    void              *state = NULL;
-    pa_idxset         *idxset;
-    struct pa_source  *source;
-
     pa_assert(u);
     pa_assert(type);
-    pa_assert(u->core);
-    pa_assert_se((idxset = u->core->sources));
-
-    while ((source = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_source_typeof(u, source, type, NULL))
-            break;
-    }
 
-    return source;
+    return pa_classify_find_sink(u, type);
 }
 
-static uint32_t hash_value(const char *s)
+static struct pa_source *find_source_by_type(struct userdata *u, const char *type)
 {
-    uint32_t hash = 0;
-    unsigned char c;
-
-    if (s) {
-        while ((c = *s++) != '\0') {
-            hash = 38501 * (hash + c);
-        }
-    }
+    pa_assert(u);
+    pa_assert(type);
 
-    return hash & PA_POLICY_GROUP_HASH_MASK;
+    return pa_classify_find_source(u, type);
 }
 
 /*
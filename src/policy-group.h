@@ -6,11 +6,7 @@
 
 #include "userdata.h"
 #include "match.h"
-
-#define PA_POLICY_GROUP_HASH_BITS 6
-#define PA_POLICY_GROUP_HASH_DIM  (1 << PA_POLICY_GROUP_HASH_BITS)
-#define PA_POLICY_GROUP_HASH_MASK (PA_POLICY_GROUP_HASH_DIM - 1)
-
+#include "atom.h"
 
 #define PA_POLICY_GROUP_BIT(b)             (1UL << (b))
 #define PA_POLICY_GROUP_FLAG_NONE          0
@@ -22,28 +18,59 @@
 #define PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY  PA_POLICY_GROUP_BIT(5)
 #define PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE PA_POLICY_GROUP_BIT(6)
 #define PA_POLICY_GROUP_FLAG_DYNAMIC_SINK  PA_POLICY_GROUP_BIT(7)
+#define PA_POLICY_GROUP_FLAG_MUTE_IN_PLACE PA_POLICY_GROUP_BIT(8)
 
 #define PA_POLICY_GROUP_FLAGS_CLIENT      (PA_POLICY_GROUP_FLAG_LIMIT_VOLUME |\
                                            PA_POLICY_GROUP_FLAG_CORK_STREAM  )
 
 #define PA_POLICY_GROUP_FLAGS_NOPOLICY     PA_POLICY_GROUP_FLAG_NONE
 
-struct pa_sink_input_list {
-    struct pa_sink_input_list    *next;
+/* group flags that have a list of their own in the groupset. Only flags
+ * whose groups are walked together get one; volume limit, cork and mute
+ * are always applied to a single group. */
+enum pa_policy_group_cap {
+    PA_POLICY_GROUP_CAP_ROUTE_AUDIO = 0,
+    PA_POLICY_GROUP_CAP_DYNAMIC_SINK,
+    PA_POLICY_GROUP_CAP_MAX
+};
+
+struct pa_policy_group;
+
+struct pa_policy_grouplist {
+    struct pa_policy_group      **groups;
+    uint32_t                      count;
+    uint32_t                      size;
+};
+
+#define PA_POLICY_GROUPLIST_FOREACH(g, list, i)                         \
+    for ((i) = 0;  (i) < (list)->count && ((g) = (list)->groups[(i)]);  (i)++)
+
+/* Group membership of a stream. The node is part of the extension
+ * of the sink input or source output. */
+struct pa_sink_input_member {
+    struct pa_policy_group       *group;    /* NULL if not in any group */
+    int                           pos;      /* position in group->sinps */
     uint32_t                      index;
     struct pa_sink_input         *sink_input;
 };
 
-struct pa_source_output_list {
-    struct pa_source_output_list *next;
+struct pa_source_output_member {
+    struct pa_policy_group       *group;
+    int                           pos;      /* position in group->souts */
     uint32_t                      index;
     struct pa_source_output      *source_output;
 };
 
+#define PA_POLICY_GROUP_FOREACH_SINK_INPUT(m, grp, i)                   \
+    for ((i) = 0;  (i) < (grp)->sinpcnt && ((m) = (grp)->sinps[(i)]);  (i)++)
+
+#define PA_POLICY_GROUP_FOREACH_SOURCE_OUTPUT(m, grp, i)                \
+    for ((i) = 0;  (i) < (grp)->soutcnt && ((m) = (grp)->souts[(i)]);  (i)++)
+
 struct pa_policy_group {
-    struct pa_policy_group       *next;     /* hash link*/
     uint32_t                      flags;    /* or'ed PA_POLICY_GROUP_FLAG_x's*/
     char                         *name;     /* name of the policy group */
+    pa_policy_atom                atom;     /* atom of the name */
     char                         *sinkname; /* name of the default sink */
     char                         *portname; /* name of the default port */
     struct pa_sink               *sink;     /* default sink for the group */
@@ -58,17 +85,34 @@ struct pa_policy_group {
     int                           corked;
     int                           mutebyrt_sink;    /* muted by routing to null sink */
     int                           mutebyrt_source;  /* muted by routing to null source */
-    struct pa_sink_input_list    *sinpls;   /* sink input list */
-    struct pa_source_output_list *soutls;   /* source output list */
+    int                           mutebyvol;        /* muted in place (no moves) */
+    int                           sinkact;  /* dynamic sink is running */
+    struct pa_sink_input_member **sinps;    /* sink input members */
+    struct pa_source_output_member **souts; /* source output members */
     int                           sinpcnt;  /* sink input counter */
     int                           soutcnt;  /* source output counter */
+    int                           sinpsize; /* allocated size of sinps */
+    int                           soutsize; /* allocated size of souts */
     int                           num_moving;   /* Number of moving streams */
     pa_proplist                  *properties;   /* properties to set for each sink input*/
 };
 
 struct pa_policy_groupset {
     struct pa_policy_group    *dflt;     /*  default group */
-    struct pa_policy_group    *hash_tbl[PA_POLICY_GROUP_HASH_DIM];
+    struct pa_policy_grouplist all;      /* every group */
+    struct pa_policy_grouplist bycap[PA_POLICY_GROUP_CAP_MAX];
+    pa_hashmap                *bysink;   /* sink index => grouplist */
+    pa_hashmap                *bysource; /* source index => grouplist */
+    struct pa_policy_grouplist sinkbound;   /* groups with a sink name */
+    struct pa_policy_grouplist sourcebound; /* or match, and source ones */
+    struct pa_policy_group   **byatom;   /* name atom => group */
+    uint32_t                   natom;
+    uint32_t                   nmoved;   /* streams moved since the last */
+                                         /* planned start of a move */
+    uint32_t                  *queue;    /* sink inputs with desired state */
+    uint32_t                   nqueue;   /* waiting to be reconciled */
+    uint32_t                   queuesize;
+    int                        deferred; /* nesting of begin/commit */
 };
 
 enum pa_policy_route_class {
@@ -78,6 +122,18 @@ enum pa_policy_route_class {
     pa_policy_route_max
 };
 
+/* Placement of the streams of the routed groups after an audio route
+ * change, as far as it is known before profiles and ports are set. */
+struct pa_policy_route_plan {
+    bool              changed[pa_policy_route_max]; /* route of the class */
+                                                    /* changes */
+    void             *target[pa_policy_route_max];  /* current device of */
+                                                    /* the target type */
+    pa_idxset        *cards;    /* cards whose profile is going to change */
+    uint32_t          detached; /* streams detached for the change */
+    uint32_t          kept;     /* streams left where they are */
+};
+
 
 struct pa_policy_groupset *pa_policy_groupset_new(struct userdata *);
 void pa_policy_groupset_free(struct pa_policy_groupset *);
@@ -85,11 +141,21 @@ void pa_policy_groupset_update_default_sink(struct userdata *, uint32_t);
 void pa_policy_groupset_register_sink(struct userdata *, struct pa_sink *);
 void pa_policy_groupset_unregister_sink(struct userdata *, uint32_t);
 void pa_policy_groupset_update_sinks(struct userdata *u);
+/* Track whether the dynamic sinks of the groups are running. With a NULL
+ * sink every dynamic sink group is checked. */
+void pa_policy_groupset_update_sink_activity(struct userdata *, struct pa_sink *);
+/* Same for every dynamic sink group, ignoring a sink that is being unlinked */
+void pa_policy_groupset_unlink_sink_activity(struct userdata *, struct pa_sink *);
 void pa_policy_groupset_register_source(struct userdata *, struct pa_source *);
 void pa_policy_groupset_unregister_source(struct userdata *, uint32_t);
 void pa_policy_groupset_update_sources(struct userdata *u);
 void pa_policy_groupset_create_default_group(struct userdata *, const char *);
 int pa_policy_groupset_restore_volume(struct userdata *, struct pa_sink *);
+/* Cork, mute, volume limit and mute-by-route changes between begin and
+ * commit only update the desired state of the streams. Commit applies
+ * what differs from the current state. */
+void pa_policy_groupset_begin(struct userdata *);
+int  pa_policy_groupset_commit(struct userdata *);
 
 struct pa_policy_group *pa_policy_group_new(struct userdata *, const char*,
                                             const char *sink,
@@ -103,14 +169,16 @@ struct pa_policy_group *pa_policy_group_new(struct userdata *, const char*,
                                             pa_proplist*, uint32_t);
 void pa_policy_group_free(struct pa_policy_groupset *, const char *);
 struct pa_policy_group *pa_policy_group_find(struct userdata *, const char *);
+struct pa_policy_group *pa_policy_group_find_atom(struct userdata *, pa_policy_atom);
 
 
-void pa_policy_group_insert_sink_input(struct userdata *, const char *,
+/* A NULL group stands for the default group */
+void pa_policy_group_insert_sink_input(struct userdata *, struct pa_policy_group *,
                                        struct pa_sink_input *, uint32_t);
 void pa_policy_group_remove_sink_input(struct userdata *, uint32_t);
 
 
-void pa_policy_group_insert_source_output(struct userdata *, const char *,
+void pa_policy_group_insert_source_output(struct userdata *, struct pa_policy_group *,
                                           struct pa_source_output *);
 void pa_policy_group_remove_source_output(struct userdata *, uint32_t);
 
@@ -118,7 +186,10 @@ void pa_policy_group_remove_source_output(struct userdata *, uint32_t);
 int  pa_policy_group_move_to(struct userdata *, const char *,
                              enum pa_policy_route_class, const char *,
                              const char *, const char *);
-int  pa_policy_group_start_move_all(struct userdata *u);
+/* Detach the streams that don't stay where they are according to the plan.
+ * Return the number of routed groups. */
+int  pa_policy_group_start_move_planned(struct userdata *u,
+                                        struct pa_policy_route_plan *plan);
 void pa_policy_group_assert_moving(struct userdata *u);
 int  pa_policy_group_cork(struct userdata *u, const char *, int);
 int  pa_policy_group_volume_limit(struct userdata *, const char *, uint32_t);
@@ -38,11 +38,15 @@ struct pa_sink_ext_data {
     PA_LLIST_HEAD(struct delayed_port_change, change_list);
     int32_t pending;
     pa_sink_ext_pending_cb pending_cb;
+    pa_idxset *volume_dirty;    /* sinks whose volume is to be set */
 };
 
 /* hooks */
 static pa_hook_result_t sink_put(void *, void *, void *);
 static pa_hook_result_t sink_unlink(void *, void *, void *);
+static pa_hook_result_t sink_proplist(void *, void *, void *);
+static pa_hook_result_t sink_state_changed(void *, void *, void *);
+static pa_hook_result_t sink_input_state_changed(void *, void *, void *);
 
 static void handle_new_sink(struct userdata *, struct pa_sink *);
 static void handle_removed_sink(struct userdata *, struct pa_sink *);
@@ -55,6 +59,7 @@ struct pa_sink_ext_data *pa_sink_ext_new()
 
     ext = pa_xnew0 (struct pa_sink_ext_data, 1);
     PA_LLIST_HEAD_INIT(struct delayed_port_change, ext->change_list);
+    ext->volume_dirty = pa_idxset_new(NULL, NULL);
 
     return ext;
 }
@@ -69,6 +74,7 @@ void pa_sink_ext_free(struct pa_sink_ext_data *ext)
             PA_LLIST_REMOVE(struct delayed_port_change, ext->change_list, change);
             delayed_port_change_free(change);
         }
+        pa_idxset_free(ext->volume_dirty, NULL);
         pa_xfree(ext);
     }
 }
@@ -87,12 +93,51 @@ struct pa_null_sink *pa_sink_ext_init_null_sink(const char *name)
 void pa_sink_ext_null_sink_free(struct pa_null_sink *null_sink)
 {
     if (null_sink != NULL) {
+        /* don't leave it suspended behind us */
+        if (null_sink->sink && null_sink->suspended)
+            pa_sink_suspend(null_sink->sink, false, PA_SUSPEND_INTERNAL);
+
         pa_xfree(null_sink->name);
 
         pa_xfree(null_sink);
     }
 }
 
+void pa_sink_ext_null_sink_update_suspend(struct userdata *u,
+                                          struct pa_sink_input *leaving)
+{
+    struct pa_null_sink *ns;
+    unsigned             playing;
+    bool                 suspended;
+
+    pa_assert(u);
+    pa_assert_se((ns = u->nullsink));
+
+    if (ns->sink == NULL)
+        return;
+
+    playing = pa_sink_used_by(ns->sink);
+
+    if (leaving && leaving->sink == ns->sink &&
+        leaving->state != PA_SINK_INPUT_CORKED && playing > 0)
+        playing--;
+
+    /* PA_SUSPEND_IDLE belongs to module-suspend-on-idle */
+    suspended = (playing == 0);
+
+    if (suspended != ns->suspended) {
+        pa_log_debug("%s null sink '%s' (%u playing stream%s)",
+                     playing ? "resume" : "suspend", ns->name,
+                     playing, playing == 1 ? "" : "s");
+
+        if (pa_sink_suspend(ns->sink, suspended, PA_SUSPEND_INTERNAL) < 0)
+            pa_log("failed to %s null sink '%s'",
+                   playing ? "resume" : "suspend", ns->name);
+        else
+            ns->suspended = suspended;
+    }
+}
+
 struct pa_sink_evsubscr *pa_sink_ext_subscription(struct userdata *u)
 {
     pa_core                 *core;
@@ -100,6 +145,9 @@ struct pa_sink_evsubscr *pa_sink_ext_subscription(struct userdata *u)
     struct pa_sink_evsubscr *subscr;
     pa_hook_slot            *put;
     pa_hook_slot            *unlink;
+    pa_hook_slot            *proplist;
+    pa_hook_slot            *sinp_state;
+    pa_hook_slot            *state;
     
     pa_assert(u);
     pa_assert_se((core = u->core));
@@ -110,12 +158,21 @@ struct pa_sink_evsubscr *pa_sink_ext_subscription(struct userdata *u)
                              PA_HOOK_LATE, sink_put, (void *)u);
     unlink = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_UNLINK_POST,
                              PA_HOOK_LATE, sink_unlink, (void *)u);
+    proplist = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_PROPLIST_CHANGED,
+                               PA_HOOK_EARLY, sink_proplist, (void *)u);
+    state  = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_STATE_CHANGED,
+                             PA_HOOK_LATE, sink_state_changed, (void *)u);
+    sinp_state = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED,
+                                 PA_HOOK_LATE, sink_input_state_changed, (void *)u);
     
 
     subscr = pa_xnew0(struct pa_sink_evsubscr, 1);
     
-    subscr->put    = put;
-    subscr->unlink = unlink;
+    subscr->put      = put;
+    subscr->unlink   = unlink;
+    subscr->proplist = proplist;
+    subscr->sinp_state = sinp_state;
+    subscr->state    = state;
 
     return subscr;
 }
@@ -125,6 +182,9 @@ void  pa_sink_ext_subscription_free(struct pa_sink_evsubscr *subscr)
     if (subscr != NULL) {
         pa_hook_slot_free(subscr->put);
         pa_hook_slot_free(subscr->unlink);
+        pa_hook_slot_free(subscr->proplist);
+        pa_hook_slot_free(subscr->sinp_state);
+        pa_hook_slot_free(subscr->state);
 
         pa_xfree(subscr);
     }
@@ -364,25 +424,25 @@ void pa_sink_ext_pending_run(struct userdata *u, pa_sink_ext_pending_cb cb)
         u->sinkext->pending_cb = cb;
 }
 
+void pa_sink_ext_need_volume(struct userdata *u, struct pa_sink *sink)
+{
+    pa_assert(u);
+    pa_assert(u->sinkext);
+    pa_assert(sink);
+
+    pa_idxset_put(u->sinkext->volume_dirty, sink, NULL);
+}
+
 void pa_sink_ext_set_volumes(struct userdata *u)
 {
     struct pa_sink     *sink;
-    struct pa_sink_ext *ext;
-    uint32_t            idx;
 
     pa_assert(u);
-    pa_assert(u->core);
-
-    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
-        ext = pa_sink_ext_lookup(u, sink);
+    pa_assert(u->sinkext);
 
-        pa_assert(ext);
-
-        if (ext->need_volume_setting) {
-            pa_log_debug("set sink '%s' volume", pa_sink_ext_get_name(sink));
-            pa_sink_set_volume(sink, NULL, true, false);
-            ext->need_volume_setting = false;
-        }
+    while ((sink = pa_idxset_steal_first(u->sinkext->volume_dirty, NULL))) {
+        pa_log_debug("set sink '%s' volume", pa_sink_ext_get_name(sink));
+        pa_sink_set_volume(sink, NULL, true, false);
     }
 }
 
@@ -490,6 +550,50 @@ static pa_hook_result_t sink_unlink(void *hook_data, void *call_data,
 }
 
 
+static pa_hook_result_t sink_proplist(void *hook_data, void *call_data,
+                                      void *slot_data)
+{
+    struct pa_sink     *sink = (struct pa_sink *)call_data;
+    struct userdata    *u    = (struct userdata *)slot_data;
+    struct pa_sink_ext *ext;
+
+    /* properties may change the device types of the sink */
+    if ((ext = pa_sink_ext_lookup(u, sink)) != NULL) {
+        pa_classify_unregister_sink(u, sink);
+        pa_classify_memo_free(ext->memo);
+        ext->memo = NULL;
+        pa_classify_register_sink(u, sink);
+        pa_policy_groupset_update_sink_activity(u, NULL);
+    }
+
+    return PA_HOOK_OK;
+}
+
+static pa_hook_result_t sink_state_changed(void *hook_data, void *call_data,
+                                           void *slot_data)
+{
+    struct pa_sink  *sink = (struct pa_sink *)call_data;
+    struct userdata *u    = (struct userdata *)slot_data;
+
+    pa_policy_groupset_update_sink_activity(u, sink);
+
+    return PA_HOOK_OK;
+}
+
+static pa_hook_result_t sink_input_state_changed(void *hook_data, void *call_data,
+                                                 void *slot_data)
+{
+    struct pa_sink_input *sinp = (struct pa_sink_input *)call_data;
+    struct userdata      *u    = (struct userdata *)slot_data;
+
+    /* a stream on the null sink was corked or uncorked by its client */
+    if (sinp->sink && sinp->sink == u->nullsink->sink)
+        pa_sink_ext_null_sink_update_suspend(u, NULL);
+
+    return PA_HOOK_OK;
+}
+
+
 static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
 {
     const char *name;
@@ -505,10 +609,17 @@ static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
         idx  = sink->index;
         ns   = u->nullsink;
 
+        ext = pa_xmalloc0(sizeof(struct pa_sink_ext));
+        pa_index_hash_add(u->hsnk, idx, ext);
+
+        pa_classify_register_sink(u, sink);
+
         if (!strcmp(name, ns->name)) {
             ns->sink = sink;
+            ns->suspended = false;
             pa_log_debug("new sink '%s' (idx=%d) will be used to "
                          "mute-by-route", name, idx);
+            pa_sink_ext_null_sink_update_suspend(u, NULL);
         }
 
         pa_policy_context_register(u, pa_policy_object_sink, name, sink);
@@ -530,11 +641,9 @@ static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
             pa_xfree(r);
         }
 
-        ext = pa_xmalloc0(sizeof(struct pa_sink_ext));
-        pa_index_hash_add(u->hsnk, idx, ext);
-
         pa_policy_groupset_update_default_sink(u, PA_IDXSET_INVALID);
         pa_policy_groupset_register_sink(u, sink);
+        pa_policy_groupset_update_sink_activity(u, NULL);
 
         pa_classify_sink(u, sink, PA_POLICY_DISABLE_NOTIFY, 0, &r);
         pa_policy_send_device_state(u, PA_POLICY_CONNECTED, r);
@@ -556,6 +665,9 @@ static void handle_removed_sink(struct userdata *u, struct pa_sink *sink)
         idx  = sink->index;
         ns   = u->nullsink;
 
+        pa_classify_unregister_sink(u, sink);
+        pa_idxset_remove_by_data(u->sinkext->volume_dirty, sink, NULL);
+
         if (ns->sink == sink) {
             pa_log_debug("cease to use sink '%s' (idx=%u) to mute-by-route",
                          name, idx);
@@ -564,6 +676,7 @@ static void handle_removed_sink(struct userdata *u, struct pa_sink *sink)
                original place */
 
             ns->sink = NULL;
+            ns->suspended = false;
         }
 
         pa_policy_context_unregister(u, pa_policy_object_sink, name, sink,idx);
@@ -581,18 +694,20 @@ static void handle_removed_sink(struct userdata *u, struct pa_sink *sink)
         pa_policy_groupset_update_default_sink(u, idx);
         pa_policy_groupset_unregister_sink(u, idx);
 
+        pa_classify_sink(u, sink, PA_POLICY_DISABLE_NOTIFY, 0, &r);
+        pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, r);
+        pa_xfree(r);
+
         if ((ext = pa_index_hash_remove(u->hsnk, idx)) == NULL)
             pa_log("no extension found for sink '%s' (idx=%u)",name, idx);
         else {
+            pa_classify_memo_free(ext->memo);
             pa_xfree(ext->overridden_port);
             pa_xfree(ext);
         }
 
-        pa_classify_sink(u, sink, PA_POLICY_DISABLE_NOTIFY, 0, &r);
-        pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, r);
-        pa_xfree(r);
-
         pa_policy_groupset_update_sinks(u);
+        pa_policy_groupset_unlink_sink_activity(u, sink);
     }
 }
 
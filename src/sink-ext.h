@@ -4,20 +4,25 @@
 #include "userdata.h"
 
 struct pa_sink;
+struct pa_classify_memo;
 
 struct pa_null_sink {
     char            *name;
     struct pa_sink  *sink;
+    bool             suspended; /* suspended by us while idle */
 };
 
 struct pa_sink_evsubscr {
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
+    pa_hook_slot    *proplist;
+    pa_hook_slot    *sinp_state;
+    pa_hook_slot    *state;
 };
 
 struct pa_sink_ext {
     char *overridden_port;
-    int   need_volume_setting;
+    struct pa_classify_memo *memo; /* device types of the sink */
 };
 
 typedef void (*pa_sink_ext_pending_cb)(struct userdata *u);
@@ -26,12 +31,18 @@ struct pa_sink_ext_data *pa_sink_ext_new();
 void pa_sink_ext_free(struct pa_sink_ext_data *ext);
 struct pa_null_sink *pa_sink_ext_init_null_sink(const char *);
 void pa_sink_ext_null_sink_free(struct pa_null_sink *);
+/* Suspend the null sink when none of its sink inputs (but 'leaving', if
+ * given) is playing, resume it otherwise. */
+void pa_sink_ext_null_sink_update_suspend(struct userdata *, struct pa_sink_input *leaving);
 struct pa_sink_evsubscr *pa_sink_ext_subscription(struct userdata *);
 void  pa_sink_ext_subscription_free(struct pa_sink_evsubscr *);
 void  pa_sink_ext_discover(struct userdata *);
 struct pa_sink_ext *pa_sink_ext_lookup(struct userdata *, struct pa_sink *);
 const char *pa_sink_ext_get_name(struct pa_sink *);
 int pa_sink_ext_set_ports(struct userdata *, const char *);
+/* Mark the volume of the sink to be set by the next pa_sink_ext_set_volumes(),
+ * which sets it once for each marked sink. */
+void pa_sink_ext_need_volume(struct userdata *, struct pa_sink *);
 void pa_sink_ext_set_volumes(struct userdata *);
 void pa_sink_ext_override_port(struct userdata *, struct pa_sink *, char *);
 void pa_sink_ext_restore_port(struct userdata *, struct pa_sink *);
@@ -34,9 +34,8 @@ static pa_hook_result_t sink_input_state_changed(pa_core *c, pa_sink_input *si,
 static pa_hook_result_t sink_input_mute_changed(pa_core *c, pa_sink_input *si, struct userdata *u);
 #endif
 
-static struct pa_policy_group* get_group(struct userdata *, const char *, pa_proplist *sinp_proplist, uint32_t *);
-static struct pa_policy_group* get_group_or_classify(struct userdata *, struct pa_sink_input *, uint32_t *);
 static void handle_new_sink_input(struct userdata *u, struct pa_sink_input *si,
+                                  struct pa_policy_pending_stream *ps,
                                   uint32_t *preserve_cork_state, uint32_t *preserve_mute_state);
 static void handle_sink_input_fixate(struct userdata *u, pa_sink_input_new_data *sinp_data);
 static void handle_removed_sink_input(struct userdata *,
@@ -80,6 +79,7 @@ struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *u)
      * used, we don't need to set up the state hooks. */
     subscr->cork_state = NULL;
     subscr->mute_state = NULL;
+    pa_policy_pending_init(&subscr->pending);
 
     return subscr;
 }
@@ -96,6 +96,8 @@ void  pa_sink_input_ext_subscription_free(struct pa_sinp_evsubscr *subscr)
         if (subscr->mute_state)
             pa_hook_slot_free(subscr->mute_state);
 
+        pa_policy_pending_done(&subscr->pending);
+
         pa_xfree(subscr);
     }
 }
@@ -111,7 +113,7 @@ void pa_sink_input_ext_discover(struct userdata *u)
     pa_assert_se((idxset = u->core->sink_inputs));
 
     while ((sinp = pa_idxset_iterate(idxset, &state, NULL)) != NULL)
-        handle_new_sink_input(u, sinp, NULL, NULL);
+        handle_new_sink_input(u, sinp, NULL, NULL, NULL);
 }
 
 void  pa_sink_input_ext_rediscover(struct userdata *u)
@@ -143,7 +145,7 @@ void  pa_sink_input_ext_rediscover(struct userdata *u)
         /* First remove sink input and then re-classify. */
         handle_removed_sink_input(u, sinp);
         pa_proplist_unset_many(sinp->proplist, clear);
-        handle_new_sink_input(u, sinp, &old_corked_state, &old_muted_state);
+        handle_new_sink_input(u, sinp, NULL, &old_corked_state, &old_muted_state);
     }
 }
 
@@ -245,13 +247,18 @@ int pa_sink_input_ext_set_volume_limit(struct userdata *u,
 
         if (!(ext = pa_sink_input_ext_lookup(u, sinp)))
             retval = -1;
+        else if (ext->local.volume_limit_enabled ?
+                 ext->local.volume_limit == limit : limit == PA_VOLUME_NORM)
+            ; /* already in effect */
         else {
             sink_input_ext_unset_volume_limit(ext, sinp);
             if (limit < PA_VOLUME_NORM) {
                 ext->local.volume_limit_enabled = true;
+                ext->local.volume_limit = limit;
                 pa_cvolume_set(&volume, sinp->sample_spec.channels, limit);
                 pa_sink_input_add_volume_factor(sinp, VOLUME_LIMIT_FACTOR_KEY, &volume);
             }
+            retval = 1;
         }
     }
 
@@ -279,6 +286,7 @@ static pa_hook_result_t sink_input_neew(void *hook_data, void *call_data,
     struct pa_sink_input_new_data
                            *data = (struct pa_sink_input_new_data *)call_data;
     struct userdata        *u    = (struct userdata *)slot_data;
+    struct pa_policy_pending_stream  *ps;
     uint32_t                flags;
     const char             *group_name;
     const char             *sinp_name;
@@ -290,23 +298,22 @@ static pa_hook_result_t sink_input_neew(void *hook_data, void *call_data,
     pa_assert(u);
     pa_assert(data);
 
-    if ((group_name = pa_classify_sink_input_by_data(u,data,&flags)) != NULL &&
-        (group      = pa_policy_group_find(u, group_name)          ) != NULL ){
+    /* only a serial set here may refer to a pending entry */
+    pa_policy_pending_clear(data->proplist);
+
+    if ((group = pa_classify_sink_input_by_data(u, data, &flags)) != NULL) {
+        group_name = group->name;
 
-        /* Let's just set the policy group property here already so that we
-         * don't have to classify again when the sink input is put, because we
-         * can just retrieve the group from the proplist. Also, this prevents
-         * the classification from breaking later because of the proplist
+        /* Remember the classification so that we don't have to classify
+         * again in the FIXATE and PUT hooks. Also, this prevents the
+         * classification from breaking later because of the proplist
          * overwriting done below. */
-        pa_proplist_sets(data->proplist, PA_PROP_POLICY_GROUP, group_name);
+        ps = pa_policy_pending_add(&u->ssi->pending, data->proplist, data,
+                                   data->client, data->module);
+        ps->group = group;
+        ps->flags = flags;
 
-        /* Proplist overwriting can also mess up the retrieval of
-         * stream-specific flags later on, so we need to store those to the
-         * proplist as well (ugly hack). We could probably cope without this
-         * one though, since the stream-specific flags don't really seem to be
-         * used. */
-        pa_proplist_set(data->proplist, PA_PROP_POLICY_STREAM_FLAGS,
-                        (void*)&flags, sizeof(flags));
+        pa_proplist_sets(data->proplist, PA_PROP_POLICY_GROUP, group_name);
 
         if (group->properties != NULL) {
             pa_proplist_update(data->proplist, PA_UPDATE_REPLACE, group->properties);
@@ -371,10 +378,14 @@ static pa_hook_result_t sink_input_neew(void *hook_data, void *call_data,
 static pa_hook_result_t sink_input_put(void *hook_data, void *call_data,
                                        void *slot_data)
 {
-    struct pa_sink_input *sinp = (struct pa_sink_input *)call_data;
-    struct userdata      *u    = (struct userdata *)slot_data;
+    struct pa_sink_input  *sinp = (struct pa_sink_input *)call_data;
+    struct userdata       *u    = (struct userdata *)slot_data;
+    struct pa_policy_pending_stream *ps;
+
+    ps = pa_policy_pending_get(&u->ssi->pending, sinp->proplist, NULL,
+                               sinp->client, sinp->module);
 
-    handle_new_sink_input(u, sinp, NULL, NULL);
+    handle_new_sink_input(u, sinp, ps, NULL, NULL);
 
     return PA_HOOK_OK;
 }
@@ -404,65 +415,9 @@ static pa_hook_result_t sink_input_unlink(void *hook_data, void *call_data,
     return PA_HOOK_OK;
 }
 
-static struct pa_policy_group* get_group(struct userdata *u, const char *group_name, pa_proplist *sinp_proplist, uint32_t *flags_ret)
-{
-    struct pa_policy_group *group = NULL;
-    const void *flags;
-    size_t len_flags = 0;
-
-    pa_assert(u);
-    pa_assert(sinp_proplist);
-
-    /* If group name is provided use that, otherwise check sink input proplist. */
-    if (!group_name)
-        /* Just grab the group name from the proplist to avoid classifying multiple
-         * times (and to avoid classifying incorrectly if properties are
-         * overwritten when handling PA_CORE_HOOK_SINK_INPUT_NEW).*/
-        group_name = pa_proplist_gets(sinp_proplist, PA_PROP_POLICY_GROUP);
-
-    if (group_name && (group = pa_policy_group_find(u, group_name)) != NULL) {
-        /* Only update flags if flags_ret is non null */
-        if (flags_ret) {
-            if (pa_proplist_get(sinp_proplist, PA_PROP_POLICY_STREAM_FLAGS, &flags, &len_flags) < 0 ||
-                len_flags != sizeof(uint32_t)) {
-
-                pa_log_warn("No stream flags in proplist or malformed flags.");
-                *flags_ret = 0;
-            } else
-                *flags_ret = *(uint32_t *)flags;
-        }
-    }
-
-    return group;
-}
-
-static struct pa_policy_group* get_group_or_classify(struct userdata *u, struct pa_sink_input *sinp, uint32_t *flags_ret) {
-    struct pa_policy_group *group;
-    const char *group_name;
-
-    pa_assert(u);
-    pa_assert(sinp);
-    pa_assert(flags_ret);
-
-    group = get_group(u, NULL, sinp->proplist, flags_ret);
-
-    if (!group) {
-        pa_log_info("Sink input '%s' is missing a policy group. "
-                    "Classifying...", sink_input_ext_get_name(sinp->proplist));
-
-        /* After classifying, search group struct using get_group, but don't try to update flags,
-         * since those are not added to the sink input yet. That will happen in
-         * handle_new_sink_input->pa_policy_group_insert_sink_input. pa_classify_sink_input already
-         * returns our flags, so we can just have those in the flags_ret. */
-        if ((group_name = pa_classify_sink_input(u, sinp, flags_ret)))
-            group = get_group(u, group_name, sinp->proplist, NULL);
-    }
-
-    return group;
-}
-
 static void handle_new_sink_input(struct userdata      *u,
                                   struct pa_sink_input *sinp,
+                                  struct pa_policy_pending_stream *ps,
                                   uint32_t *preserve_cork_state,
                                   uint32_t *preserve_mute_state)
 {
@@ -473,16 +428,36 @@ static void handle_new_sink_input(struct userdata      *u,
     uint32_t    flags = 0;
 
     if (sinp && u) {
+        idx  = sinp->index;
+        sinp_name = sink_input_ext_get_name(sinp->proplist);
+
+        if (ps != NULL) {
+            group = ps->group;
+            flags = ps->flags;
+        }
+        else {
+            /* Streams existing before the module was loaded and streams
+             * being rediscovered did not go through the NEW hook. */
+            pa_log_info("Sink input '%s' is missing a policy group. "
+                        "Classifying...", sinp_name);
+
+            group = pa_classify_sink_input(u, sinp, &flags);
+        }
+
+        pa_policy_pending_remove(&u->ssi->pending, ps, sinp->proplist);
+
+        if (!group)
+            pa_assert_se((group = u->groups->dflt));
+
         ext = pa_xmalloc0(sizeof(struct pa_sink_input_ext));
+        ext->flags       = flags;
         ext->local.route = (flags & PA_POLICY_LOCAL_ROUTE) ? true : false;
         ext->local.mute  = (flags & PA_POLICY_LOCAL_MUTE ) ? true : false;
 
-        if (pa_hashmap_get(sinp->volume_factor_items, VOLUME_LIMIT_FACTOR_KEY))
+        if (pa_hashmap_get(sinp->volume_factor_items, VOLUME_LIMIT_FACTOR_KEY)) {
             ext->local.volume_limit_enabled = true;
-
-        idx  = sinp->index;
-        sinp_name = sink_input_ext_get_name(sinp->proplist);
-        pa_assert_se((group = get_group_or_classify(u, sinp, &flags)));
+            ext->local.volume_limit = PA_VOLUME_INVALID; /* not known */
+        }
 
         if (preserve_cork_state)
             ext->local.cork_state = *preserve_cork_state;
@@ -504,13 +479,9 @@ static void handle_new_sink_input(struct userdata      *u,
         pa_index_hash_add(u->hsi, idx, ext);
 
         pa_policy_context_register(u, pa_policy_object_sink_input, sinp_name, sinp);
-        pa_policy_group_insert_sink_input(u, group->name, sinp, flags);
+        pa_policy_group_insert_sink_input(u, group, sinp, flags);
 
-        /* Proplist overwriting can also mess up the retrieval of
-         * stream-specific flags later on, so we need to store those to the
-         * proplist as well (ugly hack). We could probably cope without this
-         * one though, since the stream-specific flags don't really seem to be
-         * used. */
+        /* for the outside world only, we keep the flags in the extension */
         pa_proplist_set(sinp->proplist, PA_PROP_POLICY_STREAM_FLAGS,
                         (void*)&flags, sizeof(flags));
 
@@ -686,15 +657,20 @@ static void handle_sink_input_fixate(struct userdata *u,
                                      pa_sink_input_new_data *sinp_data)
 {
     struct pa_policy_group *group = NULL;
+    struct pa_policy_pending_stream  *ps;
     const char *sinp_name;
     int         group_volume;
     pa_cvolume  group_limit;
-    uint32_t flags;
 
     pa_assert(u);
     pa_assert(sinp_data);
 
-    pa_assert_se((group = get_group(u, NULL, sinp_data->proplist, &flags)));
+    if ((ps = pa_policy_pending_get(&u->ssi->pending, sinp_data->proplist,
+                                    sinp_data, sinp_data->client,
+                                    sinp_data->module)) == NULL)
+        return;
+
+    group = ps->group;
     sinp_name = sink_input_ext_get_name(sinp_data->proplist);
     group_volume = group->flags & PA_POLICY_GROUP_FLAG_LIMIT_VOLUME;
 
@@ -720,37 +696,39 @@ static void handle_sink_input_fixate(struct userdata *u,
 static void handle_removed_sink_input(struct userdata      *u,
                                       struct pa_sink_input *sinp)
 {
-    struct pa_policy_group *group = NULL;
     struct pa_sink_input_ext *ext;
     struct pa_sink *sink;
     uint32_t        idx;
     const char     *snam;
-    uint32_t        flags;
+    const char     *gnam;
 
     if (sinp && u) {
         idx  = sinp->index;
         sink = sinp->sink;
         snam = sink_input_ext_get_name(sinp->proplist);
-        pa_assert_se((group = get_group_or_classify(u, sinp, &flags)));
 
-        if (flags & PA_POLICY_LOCAL_ROUTE)
+        if ((ext = pa_sink_input_ext_lookup(u, sinp)) == NULL) {
+            pa_log("no extension found for sink-input '%s' (idx=%u)",snam,idx);
+            return;
+        }
+
+        gnam = ext->member.group ? ext->member.group->name : "<none>";
+
+        if (ext->flags & PA_POLICY_LOCAL_ROUTE)
             pa_sink_ext_restore_port(u, sink);
 
-        if (flags & PA_POLICY_LOCAL_MUTE)
+        if (ext->flags & PA_POLICY_LOCAL_MUTE)
             pa_policy_groupset_restore_volume(u, sink);
             
         pa_policy_context_unregister(u, pa_policy_object_sink_input,
                                      snam, sinp, sinp->index);
         pa_policy_group_remove_sink_input(u, sinp->index);
 
-        if ((ext = pa_index_hash_remove(u->hsi, idx)) == NULL)
-            pa_log("no extension found for sink-input '%s' (idx=%u)",snam,idx);
-        else {
-            pa_xfree(ext);
-        }
-
         pa_log_debug("removed sink_input '%s' (idx=%d) (group=%s)",
-                     snam, idx, group->name);
+                     snam, idx, gnam);
+
+        pa_index_hash_remove(u->hsi, idx);
+        pa_xfree(ext);
     }
 }
 
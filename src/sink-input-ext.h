@@ -11,6 +11,8 @@
 
 
 #include "userdata.h"
+#include "policy-group.h"
+#include "pending-stream.h"
 
 struct pa_sinp_evsubscr {
     pa_hook_slot    *neew;
@@ -19,6 +21,8 @@ struct pa_sinp_evsubscr {
     pa_hook_slot    *unlink;
     pa_hook_slot    *cork_state;
     pa_hook_slot    *mute_state;
+    struct pa_policy_pending pending; /* classifications of the streams */
+                                      /* that are not put yet */
 };
 
 enum pa_sink_input_ext_state {
@@ -27,6 +31,11 @@ enum pa_sink_input_ext_state {
     PA_SINK_INPUT_EXT_STATE_POLICY  = 1 << 1
 };
 
+/* parts of the desired state that are set */
+#define PA_SINK_INPUT_EXT_WANT_CORK   (1 << 0)
+#define PA_SINK_INPUT_EXT_WANT_LIMIT  (1 << 1)
+#define PA_SINK_INPUT_EXT_WANT_ROUTE  (1 << 2)
+
 struct pa_sink_input_ext {
     struct {
         int route;
@@ -36,7 +45,17 @@ struct pa_sink_input_ext {
         uint32_t mute_state;
         bool ignore_mute_state_change;
         bool volume_limit_enabled;
+        pa_volume_t volume_limit;   /* applied limit, if enabled */
     }                local;     /* local policies */
+    struct {
+        uint32_t    set;        /* PA_SINK_INPUT_EXT_WANT_* */
+        bool        corked;
+        pa_volume_t limit;      /* 0 means muted */
+        bool        to_null;    /* null sink instead of the group's sink */
+        bool        queued;     /* waiting for the groupset commit */
+    }                want;      /* desired policy state */
+    uint32_t         flags;     /* stream flags */
+    struct pa_sink_input_member member; /* membership in a policy group */
 };
 
 struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *);
@@ -49,6 +68,7 @@ struct pa_sink_input_ext *pa_sink_input_ext_lookup(struct userdata *,
 int   pa_sink_input_ext_set_policy_group(struct pa_sink_input *, const char *);
 const char *pa_sink_input_ext_get_policy_group(struct pa_sink_input *);
 const char *pa_sink_input_ext_get_name(struct pa_sink_input *);
+/* Return 1 if the volume factor was changed, 0 if not and -1 on error. */
 int   pa_sink_input_ext_set_volume_limit(struct userdata *u, struct pa_sink_input *, pa_volume_t);
 void  pa_sink_input_ext_unset_volume_limit(struct userdata *u, struct pa_sink_input *si);
 bool pa_sink_input_ext_cork(struct userdata *u, pa_sink_input *si, bool cork);
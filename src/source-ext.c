@@ -12,6 +12,8 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/source.h>
 
+#include "index-hash.h"
+
 #include "source-ext.h"
 #include "classify.h"
 #include "context.h"
@@ -23,6 +25,7 @@
 /* hooks */
 static pa_hook_result_t source_put(void *, void *, void *);
 static pa_hook_result_t source_unlink(void *, void *, void *);
+static pa_hook_result_t source_proplist(void *, void *, void *);
 
 static void handle_new_source(struct userdata *, struct pa_source *);
 static void handle_removed_source(struct userdata *, struct pa_source *);
@@ -36,6 +39,7 @@ struct pa_source_evsubscr *pa_source_ext_subscription(struct userdata *u)
     struct pa_source_evsubscr *subscr;
     pa_hook_slot              *put;
     pa_hook_slot              *unlink;
+    pa_hook_slot              *proplist;
     
     pa_assert(u);
     pa_assert_se((core = u->core));
@@ -46,12 +50,15 @@ struct pa_source_evsubscr *pa_source_ext_subscription(struct userdata *u)
                              PA_HOOK_LATE, source_put, (void *)u);
     unlink = pa_hook_connect(hooks + PA_CORE_HOOK_SOURCE_UNLINK,
                              PA_HOOK_LATE, source_unlink, (void *)u);
+    proplist = pa_hook_connect(hooks + PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED,
+                               PA_HOOK_EARLY, source_proplist, (void *)u);
 
 
     subscr = pa_xnew0(struct pa_source_evsubscr, 1);
     
-    subscr->put    = put;
-    subscr->unlink = unlink;
+    subscr->put      = put;
+    subscr->unlink   = unlink;
+    subscr->proplist = proplist;
     
     return subscr;
 }
@@ -61,6 +68,7 @@ void pa_source_ext_subscription_free(struct pa_source_evsubscr *subscr)
     if (subscr != NULL) {
         pa_hook_slot_free(subscr->put);
         pa_hook_slot_free(subscr->unlink);
+        pa_hook_slot_free(subscr->proplist);
 
         pa_xfree(subscr);
     }
@@ -80,6 +88,14 @@ void pa_source_ext_discover(struct userdata *u)
         handle_new_source(u, source);
 }
 
+struct pa_source_ext *pa_source_ext_lookup(struct userdata *u,
+                                           struct pa_source *source)
+{
+    pa_assert(u);
+    pa_assert(source);
+
+    return pa_index_hash_lookup(u->hsrc, source->index);
+}
 
 const char *pa_source_ext_get_name(struct pa_source *source)
 {
@@ -200,18 +216,42 @@ static pa_hook_result_t source_unlink(void *hook_data, void *call_data,
     return PA_HOOK_OK;
 }
 
+static pa_hook_result_t source_proplist(void *hook_data, void *call_data,
+                                        void *slot_data)
+{
+    struct pa_source     *source = (struct pa_source *)call_data;
+    struct userdata      *u = (struct userdata *)slot_data;
+    struct pa_source_ext *ext;
+
+    /* properties may change the device types of the source */
+    if ((ext = pa_source_ext_lookup(u, source)) != NULL) {
+        pa_classify_unregister_source(u, source);
+        pa_classify_memo_free(ext->memo);
+        ext->memo = NULL;
+        pa_classify_register_source(u, source);
+    }
+
+    return PA_HOOK_OK;
+}
+
 static void handle_new_source(struct userdata *u, struct pa_source *source)
 {
     const char      *name;
     uint32_t         idx;
     char            *buf;
     int              ret;
+    struct pa_source_ext      *ext;
     struct pa_classify_result *r;
 
     if (source && u) {
         name = pa_source_ext_get_name(source);
         idx  = source->index;
 
+        ext = pa_xnew0(struct pa_source_ext, 1);
+        pa_index_hash_add(u->hsrc, idx, ext);
+
+        pa_classify_register_source(u, source);
+
         if (pa_streq(name, u->nullsource->name)) {
             u->nullsource->source = source;
             pa_log_debug("new source '%s' (idx=%d) will be used to "
@@ -254,6 +294,7 @@ static void handle_removed_source(struct userdata *u, struct pa_source *source)
     uint32_t         idx;
     char            *buf;
     struct pa_null_source     *ns;
+    struct pa_source_ext      *ext;
     struct pa_classify_result *r;
 
     if (source && u) {
@@ -261,6 +302,8 @@ static void handle_removed_source(struct userdata *u, struct pa_source *source)
         idx  = source->index;
         ns   = u->nullsource;
 
+        pa_classify_unregister_source(u, source);
+
         if (ns->source == source) {
             pa_log_debug("cease to use source '%s' (idx=%u) to mute-by-route",
                          name, idx);
@@ -287,6 +330,13 @@ static void handle_removed_source(struct userdata *u, struct pa_source *source)
         pa_classify_source(u, source, PA_POLICY_DISABLE_NOTIFY, 0, &r);
         pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, r);
         pa_xfree(r);
+
+        if ((ext = pa_index_hash_remove(u->hsrc, idx)) == NULL)
+            pa_log("no extension found for source '%s' (idx=%u)", name, idx);
+        else {
+            pa_classify_memo_free(ext->memo);
+            pa_xfree(ext);
+        }
     }
 }
 
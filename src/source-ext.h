@@ -4,6 +4,7 @@
 #include "userdata.h"
 
 struct pa_source;
+struct pa_classify_memo;
 
 struct pa_null_source {
     char            *name;
@@ -13,11 +14,17 @@ struct pa_null_source {
 struct pa_source_evsubscr {
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
+    pa_hook_slot    *proplist;
+};
+
+struct pa_source_ext {
+    struct pa_classify_memo *memo; /* device types of the source */
 };
 
 struct pa_source_evsubscr *pa_source_ext_subscription(struct userdata *);
 void  pa_source_ext_subscription_free(struct pa_source_evsubscr *);
 void  pa_source_ext_discover(struct userdata *);
+struct pa_source_ext *pa_source_ext_lookup(struct userdata *, struct pa_source *);
 const char *pa_source_ext_get_name(struct pa_source *);
 int   pa_source_ext_set_mute(struct userdata *, const char *, int);
 int   pa_source_ext_set_ports(struct userdata *, const char *);
@@ -13,6 +13,7 @@
 #include <pulsecore/source-output.h>
 
 #include "policy-group.h"
+#include "index-hash.h"
 #include "source-ext.h"
 #include "source-output-ext.h"
 #include "classify.h"
@@ -25,7 +26,8 @@ static pa_hook_result_t source_output_put(void *, void *, void *);
 static pa_hook_result_t source_output_unlink(void *, void *, void *);
 
 static void handle_new_source_output(struct userdata *,
-                                     struct pa_source_output *);
+                                     struct pa_source_output *,
+                                     struct pa_policy_pending_stream *);
 static void handle_removed_source_output(struct userdata *,
                                          struct pa_source_output *);
 
@@ -56,6 +58,7 @@ struct pa_sout_evsubscr *pa_source_output_ext_subscription(struct userdata *u)
     subscr->neew   = neew;
     subscr->put    = put;
     subscr->unlink = unlink;
+    pa_policy_pending_init(&subscr->pending);
 
     
     return subscr;
@@ -67,6 +70,7 @@ void  pa_source_output_ext_subscription_free(struct pa_sout_evsubscr *subscr)
         pa_hook_slot_free(subscr->neew);
         pa_hook_slot_free(subscr->put);
         pa_hook_slot_free(subscr->unlink);
+        pa_policy_pending_done(&subscr->pending);
         
         pa_xfree(subscr);
     }
@@ -83,7 +87,31 @@ void pa_source_output_ext_discover(struct userdata *u)
     pa_assert_se((idxset = u->core->source_outputs));
 
     while ((sout = pa_idxset_iterate(idxset, &state, NULL)) != NULL)
-        handle_new_source_output(u, sout);
+        handle_new_source_output(u, sout, NULL);
+}
+
+void pa_source_output_ext_release(struct userdata *u)
+{
+    void                        *state = NULL;
+    struct pa_source_output     *sout;
+    struct pa_source_output_ext *ext;
+
+    pa_assert(u);
+    pa_assert(u->core);
+
+    while ((sout = pa_idxset_iterate(u->core->source_outputs, &state, NULL))) {
+        if ((ext = pa_index_hash_remove(u->hso, sout->index)) != NULL)
+            pa_xfree(ext);
+    }
+}
+
+struct pa_source_output_ext *pa_source_output_ext_lookup(struct userdata *u,
+                                                         struct pa_source_output *sout)
+{
+    pa_assert(u);
+    pa_assert(sout);
+
+    return pa_index_hash_lookup(u->hso, sout->index);
 }
 
 int pa_source_output_ext_set_policy_group(struct pa_source_output *sout,
@@ -143,9 +171,20 @@ static pa_hook_result_t source_output_neew(void *hook_data, void *call_data,
     const char       *sout_name;
     const char       *source_name;
     struct pa_policy_group *group;
+    struct pa_policy_pending_stream *ps;
+    uint32_t          flags = 0;
+
+    /* only a serial set here may refer to a pending entry */
+    pa_policy_pending_clear(data->proplist);
 
-    if ((group_name = pa_classify_source_output_by_data(u, data)) != NULL &&
-        (group      = pa_policy_group_find(u, group_name)       ) != NULL   ){
+    if ((group = pa_classify_source_output_by_data(u, data, &flags)) != NULL) {
+        group_name = group->name;
+
+        /* remember the classification for the PUT hook */
+        ps = pa_policy_pending_add(&u->sso->pending, data->proplist, data,
+                                   data->client, data->module);
+        ps->group = group;
+        ps->flags = flags;
 
         sout_name = pa_proplist_gets(data->proplist, PA_PROP_MEDIA_NAME);
 
@@ -186,8 +225,12 @@ static pa_hook_result_t source_output_put(void *hook_data, void *call_data,
 {
     struct pa_source_output *sout = (struct pa_source_output *)call_data;
     struct userdata         *u    = (struct userdata *)slot_data;
+    struct pa_policy_pending_stream *ps;
+
+    ps = pa_policy_pending_get(&u->sso->pending, sout->proplist, NULL,
+                               sout->client, sout->module);
 
-    handle_new_source_output(u, sout);
+    handle_new_source_output(u, sout, ps);
 
     return PA_HOOK_OK;
 }
@@ -206,20 +249,36 @@ static pa_hook_result_t source_output_unlink(void *hook_data, void *call_data,
 
 
 static void handle_new_source_output(struct userdata         *u,
-                                     struct pa_source_output *sout)
+                                     struct pa_source_output *sout,
+                                     struct pa_policy_pending_stream *ps)
 {
+    struct pa_source_output_ext *ext;
+    struct pa_policy_group      *group;
     const char *snam;
-    const char *gnam;
 
     if (sout && u) {
         snam = pa_source_output_ext_get_name(sout);
-        gnam = pa_classify_source_output(u, sout);
+
+        ext = pa_xnew0(struct pa_source_output_ext, 1);
+
+        /* Streams that went through the NEW hook are already classified,
+         * only streams existing before the module was loaded are not. */
+        if (ps != NULL) {
+            group      = ps->group;
+            ext->flags = ps->flags;
+        }
+        else
+            group = pa_classify_source_output(u, sout, &ext->flags);
+
+        pa_policy_pending_remove(&u->sso->pending, ps, sout->proplist);
+
+        pa_index_hash_add(u->hso, sout->index, ext);
 
         pa_policy_context_register(u,pa_policy_object_source_output,snam,sout);
-        pa_policy_group_insert_source_output(u, gnam, sout);
+        pa_policy_group_insert_source_output(u, group, sout);
 
         pa_log_debug("new source_output %s (idx=%d) (group=%s)",
-                     snam, sout->index, gnam);
+                     snam, sout->index, group ? group->name : "<default>");
     }
 }
 
@@ -227,19 +286,32 @@ static void handle_new_source_output(struct userdata         *u,
 static void handle_removed_source_output(struct userdata         *u,
                                          struct pa_source_output *sout)
 {
+    struct pa_source_output_ext *ext;
     const char *snam;
     const char *gnam;
+    uint32_t    idx;
 
     if (sout && u) {
         snam = pa_source_output_ext_get_name(sout);
-        gnam = pa_classify_source_output(u, sout);
+        idx  = sout->index;
 
-        pa_policy_context_unregister(u, pa_policy_object_source_output,
-                                     snam, sout, sout->index);
-        pa_policy_group_remove_source_output(u, sout->index);
+        if ((ext = pa_source_output_ext_lookup(u, sout)) == NULL) {
+            pa_log("no extension found for source-output '%s' (idx=%u)",
+                   snam, idx);
+            return;
+        }
+
+        gnam = ext->member.group ? ext->member.group->name : "<none>";
 
         pa_log_debug("removed source_output %s (idx=%d) (group=%s)",
-                     snam, sout->index, gnam);
+                     snam, idx, gnam);
+
+        pa_policy_context_unregister(u, pa_policy_object_source_output,
+                                     snam, sout, idx);
+        pa_policy_group_remove_source_output(u, idx);
+
+        pa_index_hash_remove(u->hso, idx);
+        pa_xfree(ext);
     }
 }
 
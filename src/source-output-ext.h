@@ -11,16 +11,29 @@
 
 
 #include "userdata.h"
+#include "policy-group.h"
+#include "pending-stream.h"
 
 struct pa_sout_evsubscr {
     pa_hook_slot    *neew;
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
+    struct pa_policy_pending pending; /* classifications of the streams */
+                                      /* that are not put yet */
+};
+
+struct pa_source_output_ext {
+    uint32_t                        flags;  /* stream flags */
+    struct pa_source_output_member  member; /* membership in a policy group */
 };
 
 struct pa_sout_evsubscr *pa_source_output_ext_subscription(struct userdata *);
 void  pa_source_output_ext_subscription_free(struct pa_sout_evsubscr *);
 void  pa_source_output_ext_discover(struct userdata *);
+/* free the extensions of the existing source outputs on unload */
+void  pa_source_output_ext_release(struct userdata *);
+struct pa_source_output_ext *pa_source_output_ext_lookup(struct userdata *,
+                                                         struct pa_source_output *);
 int   pa_source_output_ext_set_policy_group(struct pa_source_output *, const char *);
 const char *pa_source_output_ext_get_policy_group(struct pa_source_output *sout);
 const char *pa_source_output_ext_get_name(struct pa_source_output *sout);
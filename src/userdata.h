@@ -9,6 +9,8 @@
 
 #define PA_PROP_APPLICATION_PROCESS_ARGS "application.process.args"
 #define PA_PROP_APPLICATION_PROCESS_ARG0 "application.process.arg0"
+#define PA_PROP_APPLICATION_PROCESS_EXE  "application.process.exe"
+#define PA_PROP_APPLICATION_PROCESS_CGROUP "application.process.cgroup"
 #define PA_PROP_POLICY_GROUP             "policy.group"
 #define PA_PROP_POLICY_STREAM_FLAGS      "policy.stream_flags"
 #define PA_PROP_POLICY_DEVTYPELIST       "policy.device.typelist"
@@ -38,6 +40,9 @@ struct userdata {
     struct pa_null_source     *nullsource;
     struct pa_index_hash      *hsnk;     /* sink index hash */
     struct pa_index_hash      *hsi;      /* sink input index hash */
+    struct pa_index_hash      *hso;      /* source output index hash */
+    struct pa_index_hash      *hsrc;     /* source index hash */
+    struct pa_index_hash      *hcrd;     /* card index hash */
     struct pa_client_evsubscr *scl;      /* client event susbscription */
     struct pa_sink_evsubscr   *ssnk;     /* sink event subscription */
     struct pa_source_evsubscr *ssrc;     /* source event subscription */